@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "rigidWarpFunctor.hpp"
+
+// Multi-threaded CPU executor of the rigid warp: the output rows are split in
+// contiguous slabs, one per thread, and every depth column is computed by the
+// same functor as the HIP kernel, so the output matches the GPU byte for byte
+// and does not depend on the number of threads (0 = one per hardware thread).
+inline void rigidWarpXYPlaneCPU(const RigidWarp &warp, const uint8_t *input,
+                                uint8_t *output, int threads = 0) {
+  if (threads <= 0)
+    threads = (int)std::thread::hardware_concurrency();
+  threads = std::max(1, std::min(threads, warp.size));
+
+  auto warp_rows = [&](const int row_begin, const int row_end) {
+    for (int row = row_begin; row < row_end; row++)
+      for (int col = 0; col < warp.size; col++)
+        warp.column(input, row, col,
+                    output + ((size_t)row * warp.size + col) * warp.depth);
+  };
+
+  auto slab_begin = [&](int t) { return (int)((long long)warp.size * t / threads); };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
+    workers.emplace_back(warp_rows, slab_begin(t), slab_begin(t + 1));
+  warp_rows(slab_begin(0), slab_begin(1));
+  for (auto &worker : workers)
+    worker.join();
+}
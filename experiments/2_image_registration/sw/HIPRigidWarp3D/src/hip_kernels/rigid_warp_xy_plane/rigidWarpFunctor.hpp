@@ -0,0 +1,129 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Single source of the rigid in-plane warp: the HIP kernel (rigidWarpXYPlane),
+// the CPU executor (rigidWarpCPU.hpp) and the software column warp of irg_app
+// (image_utils.hpp) all map and interpolate through this functor, so their
+// outputs are byte-identical.
+//
+// Volume layout: voxel (row, col, slice) is at (row * size + col) * depth + slice.
+// The source position of output pixel (col, row) is R(ang) ((col, row) - c) + c - t
+// with c = size / 2; pixels outside the volume read as 0.
+
+#if defined(__HIPCC__)
+#include <hip/hip_runtime.h>
+#define RIGID_WARP_HOST_DEVICE __host__ __device__
+#else
+#define RIGID_WARP_HOST_DEVICE
+#endif
+
+// A fused multiply-add rounds differently from a multiply followed by an add:
+// contraction stays off so host and device compute the same positions (host
+// code is also built with -ffp-contract=off).
+#if defined(__clang__)
+#define RIGID_WARP_NO_CONTRACT _Pragma("clang fp contract(off)")
+#else
+#define RIGID_WARP_NO_CONTRACT
+#endif
+
+struct RigidWarp {
+  int size;
+  int depth;
+  float p_cos, p_sin; // computed once on the host: device cosf/sinf may differ in the last bit
+  float translate_x, translate_y;
+  bool bilinear;
+
+  static RigidWarp make(const int size, const int depth, const float tx,
+                        const float ty, const float ang, const bool bilinear) {
+    return RigidWarp{size, depth, std::cos(ang), std::sin(ang), tx, ty, bilinear};
+  }
+
+  // nearest-neighbour source pixel of output pixel (col, row), possibly out of bounds
+  RIGID_WARP_HOST_DEVICE void nearest_source(const int col, const int row,
+                                             int &src_col, int &src_row) const {
+    RIGID_WARP_NO_CONTRACT
+    const float half_size = size / 2.f;
+#ifndef USE_FLOOR
+    src_col = roundf((col - half_size) * p_cos - (row - half_size) * p_sin - translate_x + half_size);
+    src_row = roundf((col - half_size) * p_sin + (row - half_size) * p_cos - translate_y + half_size);
+#else
+    src_col = floorf((col - half_size) * p_cos - (row - half_size) * p_sin - translate_x + half_size);
+    src_row = floorf((col - half_size) * p_sin + (row - half_size) * p_cos - translate_y + half_size);
+#endif
+  }
+
+  // bilinear source position of output pixel (col, row)
+  RIGID_WARP_HOST_DEVICE void bilinear_source(const int col, const int row,
+                                              float &src_col, float &src_row) const {
+    RIGID_WARP_NO_CONTRACT
+    const float half_size = size / 2.f;
+    src_col = (col - half_size - translate_x) * p_cos - (row - half_size - translate_y) * p_sin + half_size;
+    src_row = (col - half_size - translate_x) * p_sin + (row - half_size - translate_y) * p_cos + half_size;
+  }
+
+  RIGID_WARP_HOST_DEVICE bool in_bounds(const int col, const int row) const {
+    return col >= 0 && col < size && row >= 0 && row < size;
+  }
+
+  RIGID_WARP_HOST_DEVICE uint8_t read(const uint8_t *input, const int col,
+                                      const int row, const int slice) const {
+    return in_bounds(col, row) ? input[(row * size + col) * depth + slice] : 0;
+  }
+
+  // pixel at integer-valued float coordinates, checked before the conversion to int
+  RIGID_WARP_HOST_DEVICE uint8_t read(const uint8_t *input, const float col,
+                                      const float row, const int slice) const {
+    const bool inside = col >= 0 && col < size && row >= 0 && row < size;
+    return inside ? input[((int)row * size + (int)col) * depth + slice] : 0;
+  }
+
+  // bilinear value of slice `slice` around source position (p_col, p_row);
+  // the blend rounds half away from zero
+  RIGID_WARP_HOST_DEVICE uint8_t blend(const uint8_t *input, const float p_col,
+                                       const float p_row, const int slice) const {
+    RIGID_WARP_NO_CONTRACT
+    const float left = floorf(p_col), right = ceilf(p_col);
+    const float top = floorf(p_row), bottom = ceilf(p_row);
+    const float q11 = read(input, left, top, slice);
+    const float q12 = read(input, right, top, slice);
+    const float q21 = read(input, left, bottom, slice);
+    const float q22 = read(input, right, bottom, slice);
+
+    const float r_col = p_col - left;
+    const float r_row = p_row - top;
+    const float val_top = q11 * (1.f - r_col) + q12 * r_col;
+    const float val_bottom = q21 * (1.f - r_col) + q22 * r_col;
+    return (uint8_t)roundf(val_top * (1.f - r_row) + val_bottom * r_row);
+  }
+
+  // output voxel (row, col, slice)
+  RIGID_WARP_HOST_DEVICE uint8_t operator()(const uint8_t *input, const int row,
+                                            const int col, const int slice) const {
+    if (!bilinear) {
+      int src_col, src_row;
+      nearest_source(col, row, src_col, src_row);
+      return read(input, src_col, src_row, slice);
+    }
+    float p_col, p_row;
+    bilinear_source(col, row, p_col, p_row);
+    return blend(input, p_col, p_row, slice);
+  }
+
+  // the whole depth column of output pixel (row, col), mapped once; same bytes
+  // as operator() on every slice
+  RIGID_WARP_HOST_DEVICE void column(const uint8_t *input, const int row,
+                                     const int col, uint8_t *output) const {
+    if (!bilinear) {
+      int src_col, src_row;
+      nearest_source(col, row, src_col, src_row);
+      for (int slice = 0; slice < depth; slice++)
+        output[slice] = read(input, src_col, src_row, slice);
+      return;
+    }
+    float p_col, p_row;
+    bilinear_source(col, row, p_col, p_row);
+    for (int slice = 0; slice < depth; slice++)
+      output[slice] = blend(input, p_col, p_row, slice);
+  }
+};
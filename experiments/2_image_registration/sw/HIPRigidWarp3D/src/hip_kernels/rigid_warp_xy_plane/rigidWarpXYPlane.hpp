@@ -1,6 +1,8 @@
 #pragma once
 #include "../../utils/timer.hpp"
+#include "rigidWarpCPU.hpp"
 #include <hip/hip_runtime.h>
+#include <vector>
 
 class RigidWarpXYPlane {
   int _device_id;
@@ -13,6 +15,12 @@ class RigidWarpXYPlane {
   int _size;
   int _depth;
 
+  // CPU fallback (see useCPU)
+  bool _use_cpu = false;
+  int _cpu_threads = 0;
+  std::vector<uint8_t> host_input;
+  std::vector<uint8_t> host_output;
+
 public:
   RigidWarpXYPlane(const int device_id = 0);
 
@@ -23,11 +31,21 @@ public:
   void setupGrid(const dim3 blockSize, const dim3 gridSize);
   void setupGrid(const int threads_per_block = 1024);
 
-  double run(const float tx, const float ty, const float ang);
+  // Runs the warp on the CPU (rigidWarpXYPlaneCPU, same output as the kernel)
+  // instead of the GPU, e.g. when the GPUs are saturated; threads = 0 uses one
+  // per hardware thread. The loaded volume follows, and the buffers of the side
+  // that is left are freed. Also enabled automatically when the volumes cannot
+  // be allocated on the GPU. run_external always uses the GPU.
+  void useCPU(const bool enable, const int threads = 0);
+  bool usingCPU() const { return _use_cpu; }
+
+  double run(const float tx, const float ty, const float ang,
+             const bool bilinear = false);
 
   double run_external(const uint8_t *dev_input, uint8_t *dev_output,
                       const float tx, const float ty, const float ang,
-                      uint32_t size, uint32_t depth);
+                      uint32_t size, uint32_t depth,
+                      const bool bilinear = false);
 
   void moveToGPU(uint8_t *dev_buffer, const uint8_t *host_buffer,
                  const int size, const int depth);
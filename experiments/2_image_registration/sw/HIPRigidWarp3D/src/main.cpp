@@ -10,8 +10,16 @@ int main(int argc, char** argv) {
     
     
     if (args.task == main_parsed_args::Task::RIGID_WARP) {
+#ifndef RIGID_WARP_CPU_ONLY
         // Chiamata alla trasformata HIP
         test_rigid_warp_hip(argc, argv);
+#else
+        std::cerr << "The HIP warp is not available in the CPU-only build" << std::endl;
+        return 1;
+#endif
+    } else if (args.task == main_parsed_args::Task::RIGID_WARP_CHECK) {
+        // CPU executor (and HIP kernel, when available) against the functor
+        return test_rigid_warp_check(argc, argv);
     } else {
         std::cerr << "Invalid task" << std::endl;
     }
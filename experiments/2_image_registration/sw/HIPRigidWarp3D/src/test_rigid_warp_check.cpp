@@ -0,0 +1,96 @@
+#include "tests.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "hip_kernels/rigid_warp_xy_plane/rigidWarpCPU.hpp"
+#ifndef RIGID_WARP_CPU_ONLY
+#include <hip/hip_runtime.h>
+#include "hip_kernels/rigid_warp_xy_plane/rigidWarpXYPlane.hpp"
+#endif
+
+#include <args_parser.h>
+
+// Byte equality of every executor of the rigid warp, in both modes, against the
+// functor applied one voxel at a time (the order of the HIP kernel):
+// - the CPU executor with 1 thread and with one thread per hardware thread
+// - the HIP kernel and the CPU fallback of RigidWarpXYPlane (HIP build only)
+// The software warp of irg_app is checked against the functor by
+// warp_equivalence_check.cpp (it needs OpenCV).
+// Returns the number of mismatching runs.
+int test_rigid_warp_check(int argc, char** argv) {
+    rigid_warp_parsed_args args = rigid_warp_parse_args(argc, argv);
+    if (args.size <= 0 || args.depth <= 0)
+        return 1;
+
+    std::printf("Size:  %4d\n", args.size);
+    std::printf("Depth: %4d\n", args.depth);
+
+    const size_t VOLUME = (size_t)args.size * args.size * args.depth;
+    std::vector<uint8_t> input(VOLUME), reference(VOLUME), output(VOLUME);
+    srand(1234);
+    for (size_t i = 0; i < VOLUME; i++)
+        input[i] = rand() % 256;
+
+    // the transform of the command line, plus half-pixel translations, large
+    // translations and angles in every quadrant
+    struct Transform { float tx, ty, ang; };
+    const std::vector<Transform> transforms = {
+        {args.tx, args.ty, args.ang}, {0.f, 0.f, 0.f}, {-14.f, -7.f, 0.1f},
+        {0.5f, -2.5f, 0.f}, {80.f, -80.f, -0.3f}, {3.3f, 17.7f, 1.5707964f},
+        {-40.f, 25.f, 2.5f}, {10.f, 10.f, -3.1f}};
+
+#ifndef RIGID_WARP_CPU_ONLY
+    RigidWarpXYPlane gpu;
+    gpu.transferToGPU(input.data(), args.size, args.depth);
+    RigidWarpXYPlane fallback;
+    fallback.useCPU(true);
+    fallback.transferToGPU(input.data(), args.size, args.depth);
+#endif
+
+    int failures = 0;
+    auto check = [&](const char *executor, const char *mode, const Transform &t) {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < VOLUME; i++)
+            mismatches += output[i] != reference[i];
+        if (mismatches != 0) {
+            std::printf("FAIL %-14s %-8s tx %8.3f ty %8.3f ang %8.4f: %zu voxels differ\n",
+                        executor, mode, t.tx, t.ty, t.ang, mismatches);
+            failures++;
+        }
+    };
+
+    for (const bool bilinear : {false, true}) {
+        const char *mode = bilinear ? "bilinear" : "nearest";
+        for (const Transform &t : transforms) {
+            const RigidWarp warp = RigidWarp::make(args.size, args.depth, t.tx, t.ty, t.ang, bilinear);
+            for (int row = 0; row < args.size; row++)
+                for (int col = 0; col < args.size; col++)
+                    for (int slice = 0; slice < args.depth; slice++)
+                        reference[((size_t)row * args.size + col) * args.depth + slice] = warp(input.data(), row, col, slice);
+
+            std::memset(output.data(), 0xAA, VOLUME);
+            rigidWarpXYPlaneCPU(warp, input.data(), output.data(), 1);
+            check("cpu-1-thread", mode, t);
+            std::memset(output.data(), 0xAA, VOLUME);
+            rigidWarpXYPlaneCPU(warp, input.data(), output.data());
+            check("cpu-threads", mode, t);
+
+#ifndef RIGID_WARP_CPU_ONLY
+            gpu.run(t.tx, t.ty, t.ang, bilinear);
+            gpu.transferFromGPU(output.data());
+            check("hip-kernel", mode, t);
+            fallback.run(t.tx, t.ty, t.ang, bilinear);
+            fallback.transferFromGPU(output.data());
+            check("cpu-fallback", mode, t);
+#endif
+        }
+    }
+
+    std::printf("%s: %d mismatching run%s over %zu transforms in 2 modes\n",
+                failures == 0 ? "PASS" : "FAIL", failures, failures != 1 ? "s" : "",
+                transforms.size());
+    return failures;
+}
@@ -1,3 +1,4 @@
 #pragma once
 
 int test_rigid_warp_hip(int argc, char** argv);
+int test_rigid_warp_check(int argc, char** argv);
@@ -65,6 +65,8 @@ main_parsed_args main_parse_args(int argc, char *argv[])
             task = main_parsed_args::Task::IRON_MI_3D;
         } else if (taskArg.getValue() == "WARP") {
             task = main_parsed_args::Task::RIGID_WARP;
+        } else if (taskArg.getValue() == "CHECK") {
+            task = main_parsed_args::Task::RIGID_WARP_CHECK;
         } else {
             std::cerr << "Invalid task: " << taskArg.getValue() << std::endl;
         }
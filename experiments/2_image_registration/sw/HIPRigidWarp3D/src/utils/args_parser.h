@@ -22,6 +22,7 @@ struct main_parsed_args {
         IRON_MI,
         IRON_MI_3D,
         RIGID_WARP,
+        RIGID_WARP_CHECK,
         NONE
     } task;
 };
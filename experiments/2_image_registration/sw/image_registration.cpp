@@ -61,6 +61,7 @@ Santambrogio]
 
 #include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -68,6 +69,7 @@ Santambrogio]
 #include <memory>
 #include <numeric>
 #include <opencv2/opencv.hpp>
+#include <string>
 
 #include "constants.h"
 #include "HIPRigidWarp3D/src/utils/images_io.h"
@@ -157,6 +159,11 @@ int main(int argc, char **argv) {
   int gpu_id = argc >= 10 ? atoi(argv[10]) : 0;
 
   const int padding = 0;
+  // registration strategy, by name (register_algorithms.hpp)
+  const char *algorithm_env = std::getenv("REG_ALGORITHM");
+  const std::string algorithm =
+      algorithm_env ? algorithm_env : "mutualinformation";
+  std::cout << "Registration algorithm: " << algorithm << std::endl;
   std::cout << "Number of couples: " << depth << std::endl;
   std::cout << "RangeX: " << rangeX << std::endl;
   std::cout << "RangeY: " << rangeY << std::endl;
@@ -164,6 +171,14 @@ int main(int argc, char **argv) {
   std::cout << "Number of couples: " << depth << std::endl;
   auto available_fusion_names = imagefusion::fusion_strategies();
   auto available_register_names = imagefusion::register_strategies();
+  if (std::find(available_register_names.begin(), available_register_names.end(),
+                algorithm) == available_register_names.end()) {
+    std::cerr << "Unknown REG_ALGORITHM \"" << algorithm << "\", expected one of:";
+    for (const std::string &name : available_register_names)
+      std::cerr << " " << name;
+    std::cerr << std::endl;
+    return 1;
+  }
   std::cout << "REF path: " << ct_path << std::endl;
   std::cout << "FLOAT path: " << pet_path << std::endl;
   file_repository files(ct_path, pet_path);
@@ -215,7 +230,7 @@ int main(int argc, char **argv) {
     board.load_ref(ct_path);
     board.load_flt(pet_path);
     double execution_time = imagefusion::perform_fusion_from_files_3d(
-        reference_image, floating_image, "mutualinformation", "alphablend",
+        reference_image, floating_image, algorithm, "alphablend",
         board, rangeX, rangeY, rangeAngZ);
     execution_times.push_back(execution_time);
     std::cout << "Execution time for run " << i + 1 << ": " << execution_time
@@ -245,7 +260,7 @@ int main(int argc, char **argv) {
       new uint8_t[DIMENSION * DIMENSION * (depth + padding)];
   for (int i = 0; i < runs; i++) {
     double execution_time = imagefusion::perform_fusion_from_files_3d(
-        reference_image, floating_image, "mutualinformation", "alphablend",
+        reference_image, floating_image, algorithm, "alphablend",
         depth, padding, rangeX, rangeY, rangeAngZ, registered_volume);
     execution_times.push_back(execution_time);
     std::cout << "Execution time for run " << i + 1 << ": " << execution_time
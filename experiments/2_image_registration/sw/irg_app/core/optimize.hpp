@@ -52,8 +52,148 @@
 #ifndef OPTIMIZE_HPP
 #define OPTIMIZE_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 //int count = 0;
+
+// tolerance of the golden-section searches: a line search stops when its two
+// probes are this close
+const double LINE_SEARCH_TOLERANCE = 0.00005;
+
+// ratio by which a golden-section iteration shrinks the bracket; with the
+// exact value the surviving probe of an iteration is, up to rounding, one of
+// the probes of the next, so a CostCache evaluates only one new point per
+// iteration
+const double GOLDEN_RATIO = 1.6180339887498949;
+
+/**
+ * @brief CostCache memoizes a cost function over parameter vectors. The key
+ *        of a vector is each parameter rounded to a multiple of the quantum,
+ *        so points closer than the optimizer tolerance share one evaluation
+ *        (e.g. the surviving probe of a golden-section iteration and the
+ *        point Powell re-evaluates after each line search).
+ *        A cache is only valid for one cost function: build a new one when
+ *        the function changes (another volume, sample or pyramid level).
+ */
+class CostCache {
+public:
+   explicit CostCache(double quantum = LINE_SEARCH_TOLERANCE) : quantum(quantum) {}
+
+   template <typename Iter>
+   std::vector<long long> key(Iter first, Iter last) const {
+      std::vector<long long> k;
+      for (Iter it = first; it != last; ++it) {
+         k.push_back(std::llround(*it / quantum));
+      }
+      return k;
+   }
+
+   // true and the cached cost in cost when the key has been evaluated
+   bool find(const std::vector<long long> &k, double &cost) {
+      auto entry = costs.find(k);
+      if (entry == costs.end()) {
+         misses++;
+         return false;
+      }
+      hits++;
+      cost = entry->second;
+      return true;
+   }
+
+   void insert(const std::vector<long long> &k, double cost) { costs[k] = cost; }
+
+   void print_stats(const std::string &name, std::ostream &os = std::cout) const {
+      os << name << " cost cache: " << misses << " evaluations";
+      if (batches != 0) {
+         os << " in " << batches << " batches";
+      }
+      os << ", " << hits << " hits ("
+         << (hits + misses ? 100.0 * hits / (hits + misses) : 0.0)
+         << "% of the calls)" << std::endl;
+   }
+
+   uint64_t hits = 0;
+   uint64_t misses = 0;  // calls that reached the cost function
+   uint64_t batches = 0; // calls of a batch cost function (round trips)
+
+private:
+   double quantum;
+   std::map<std::vector<long long>, double> costs;
+};
+
+/**
+ * @brief cached_cost_function wraps a cost function taking an iterator to
+ *        n parameters (as used by optimize_powell) with a CostCache
+ */
+template <typename Iter, typename Cf>
+auto cached_cost_function(CostCache &cache, std::size_t n, Cf cost_function)
+{
+   return [&cache, n, cost_function](Iter params) mutable {
+      const std::vector<long long> k = cache.key(params, params + n);
+      double cost;
+      if (!cache.find(k, cost)) {
+         cost = cost_function(params);
+         cache.insert(k, cost);
+      }
+      return cost;
+   };
+}
+
+/**
+ * @brief cached_batch_cost_function wraps a batch cost function (as used by
+ *        optimize_powell_batch) with a CostCache: only the candidates missing
+ *        from the cache, each once, are submitted to batch_cost_function
+ */
+template <typename Bcf>
+auto cached_batch_cost_function(CostCache &cache, Bcf batch_cost_function)
+{
+   return [&cache, batch_cost_function](const auto &candidates) mutable {
+      using Candidates = typename std::decay<decltype(candidates)>::type;
+      std::vector<double> costs(candidates.size());
+      std::vector<std::vector<long long>> keys;
+      Candidates misses;
+      std::vector<std::size_t> slot(candidates.size()); // index in misses
+      for (std::size_t i = 0; i < candidates.size(); ++i) {
+         const std::vector<long long> k = cache.key(candidates[i].begin(), candidates[i].end());
+         std::size_t j = 0;
+         while (j < keys.size() && keys[j] != k) {
+            ++j;
+         }
+         if (j < keys.size()) {
+            cache.hits++; // repeated within the batch
+            slot[i] = j;
+         } else if (cache.find(k, costs[i])) {
+            slot[i] = SIZE_MAX;
+         } else {
+            keys.push_back(k);
+            misses.push_back(candidates[i]);
+            slot[i] = j;
+         }
+      }
+      if (!misses.empty()) {
+         cache.batches++;
+         const std::vector<double> computed = batch_cost_function(misses);
+         for (std::size_t j = 0; j < keys.size(); ++j) {
+            cache.insert(keys[j], computed[j]);
+         }
+         for (std::size_t i = 0; i < candidates.size(); ++i) {
+            if (slot[i] != SIZE_MAX) {
+               costs[i] = computed[slot[i]];
+            }
+         }
+      }
+      return costs;
+   };
+}
+
 /**
  * @brief optimize_goldensectionsearch is a line optimization strategy
  * @param init start value
@@ -66,10 +206,10 @@ T optimize_goldensectionsearch(T init, T rng, F function)
 {
    T sta = init - 0.382*rng;
    T end = init + 0.618*rng;
-   T c = (end - (end-sta)/1.618);
-   T d = (sta + (end-sta)/1.618);
+   T c = (end - (end-sta)/GOLDEN_RATIO);
+   T d = (sta + (end-sta)/GOLDEN_RATIO);
 
-   while (fabs(c-d) > 0.00005) {
+   while (fabs(c-d) > LINE_SEARCH_TOLERANCE) {
       //count++;
       if (function(c) < function(d)) {
          end = d;
@@ -77,20 +217,458 @@ T optimize_goldensectionsearch(T init, T rng, F function)
          sta = c;
       }
 
-      c = (end - (end-sta)/1.618);
-      d = (sta + (end-sta)/1.618);
+      c = (end - (end-sta)/GOLDEN_RATIO);
+      d = (sta + (end-sta)/GOLDEN_RATIO);
+   }
+
+   return (end+sta)/2;
+}
+
+/**
+ * @brief optimize_goldensectionsearch_batch is the golden-section search of
+ *        optimize_goldensectionsearch where the two probes of an iteration
+ *        are submitted together, so that a batch-capable cost function can
+ *        evaluate them in a single pass
+ * @param init start value
+ * @param rng range to look in
+ * @param batch_function cost function taking a vector of values and
+ *        returning the vector of their costs
+ * @return instance of T for which function is minimal
+ */
+template <typename T, typename BF>
+T optimize_goldensectionsearch_batch(T init, T rng, BF batch_function)
+{
+   T sta = init - 0.382*rng;
+   T end = init + 0.618*rng;
+   T c = (end - (end-sta)/GOLDEN_RATIO);
+   T d = (sta + (end-sta)/GOLDEN_RATIO);
+
+   while (fabs(c-d) > LINE_SEARCH_TOLERANCE) {
+      const std::vector<double> costs = batch_function(std::vector<T>{c, d});
+      if (costs[0] < costs[1]) {
+         end = d;
+      } else {
+         sta = c;
+      }
+
+      c = (end - (end-sta)/GOLDEN_RATIO);
+      d = (sta + (end-sta)/GOLDEN_RATIO);
    }
 
    return (end+sta)/2;
 }
 
+/**
+ * @brief optimize_brent is Brent's line minimization: a parabola through the
+ *        three best points found so far proposes the next probe, and a
+ *        golden-section step is taken instead when the parabolic step is not
+ *        trusted (outside the bracket, or not shrinking fast enough). Near a
+ *        smooth minimum it converges much faster than golden section, while
+ *        the golden steps bound the worst case. It starts from init, in the
+ *        same bracket and with the same tolerance as
+ *        optimize_goldensectionsearch.
+ * @param init start value
+ * @param rng range to look in
+ * @param function cost function
+ * @return instance of T for which function is minimal
+ */
+template <typename T, typename F>
+T optimize_brent(T init, T rng, F function)
+{
+   const T CGOLD = 2.0 - GOLDEN_RATIO;
+   const T tol1 = LINE_SEARCH_TOLERANCE;
+   const T tol2 = 2*tol1;
+   T a = init - 0.382*rng;
+   T b = init + 0.618*rng;
+   // x: best point, w: second best, v: previous value of w
+   T x = init, w = init, v = init;
+   double fx = function(x), fw = fx, fv = fx;
+   T d = 0; // last step
+   T e = 0; // step before the last one
+
+   while (true) {
+      const T xm = (a+b)/2;
+      if (fabs(x-xm) <= tol2 - (b-a)/2) {
+         break;
+      }
+      bool golden = true;
+      if (fabs(e) > tol1) {
+         T r = (x-w)*(fx-fv);
+         T q = (x-v)*(fx-fw);
+         T p = (x-v)*q - (x-w)*r;
+         q = 2*(q-r);
+         if (q > 0) {
+            p = -p;
+         } else {
+            q = -q;
+         }
+         const T etemp = e;
+         e = d;
+         // the parabolic step must be less than half the step before last
+         // and land inside the bracket
+         if (fabs(p) < fabs(q*etemp/2) && p > q*(a-x) && p < q*(b-x)) {
+            d = p/q;
+            const T u = x + d;
+            if (u-a < tol2 || b-u < tol2) {
+               d = xm >= x ? tol1 : -tol1;
+            }
+            golden = false;
+         }
+      }
+      if (golden) {
+         e = x >= xm ? a-x : b-x;
+         d = CGOLD*e;
+      }
+      // never probe closer than the tolerance to x
+      const T u = fabs(d) >= tol1 ? x+d : x + (d >= 0 ? tol1 : -tol1);
+      const double fu = function(u);
+      if (fu <= fx) {
+         if (u >= x) {
+            a = x;
+         } else {
+            b = x;
+         }
+         v = w; fv = fw;
+         w = x; fw = fx;
+         x = u; fx = fu;
+      } else {
+         if (u < x) {
+            a = u;
+         } else {
+            b = u;
+         }
+         if (fu <= fw || w == x) {
+            v = w; fv = fw;
+            w = u; fw = fu;
+         } else if (fu <= fv || v == x || v == w) {
+            v = u; fv = fu;
+         }
+      }
+   }
+
+   return x;
+}
+
+// Line searches of optimize_powell and optimize_powell_batch: GOLDEN_SECTION
+// probes two points per iteration, K_SECTION probes ksection_probes() evenly
+// spaced points per iteration (as one batch), BRENT takes parabolic steps with
+// a golden-section fallback (one point per iteration)
+enum LineSearch { GOLDEN_SECTION = 0, K_SECTION = 1, BRENT = 2 };
+
+// compile-time default of the line search
+#ifndef REG_LINE_SEARCH
+#define REG_LINE_SEARCH GOLDEN_SECTION
+#endif
+
+// interior points of a k-section iteration (compile-time default)
+#ifndef REG_KSECTION_PROBES
+#define REG_KSECTION_PROBES 3
+#endif
+
+// the REG_LINE_SEARCH environment variable ("golden", "ksection" or "brent")
+// takes precedence over the compile-time default
+inline LineSearch &line_search_setting() {
+   static LineSearch search = []() {
+      const char *env = std::getenv("REG_LINE_SEARCH");
+      if (env && std::string(env) == "golden") return GOLDEN_SECTION;
+      if (env && std::string(env) == "ksection") return K_SECTION;
+      if (env && std::string(env) == "brent") return BRENT;
+      return (LineSearch)REG_LINE_SEARCH;
+   }();
+   return search;
+}
+
+// overrides the line search at runtime
+inline void set_line_search(const LineSearch search) {
+   line_search_setting() = search;
+}
+
+inline LineSearch line_search() {
+   return line_search_setting();
+}
+
+// the REG_KSECTION_PROBES environment variable takes precedence over the
+// compile-time default
+inline int &ksection_probes_setting() {
+   static int probes = []() {
+      const char *env = std::getenv("REG_KSECTION_PROBES");
+      return env ? std::atoi(env) : REG_KSECTION_PROBES;
+   }();
+   return probes;
+}
+
+// overrides the number of k-section probes at runtime (at least 2)
+inline void set_ksection_probes(const int probes) {
+   ksection_probes_setting() = probes;
+}
+
+inline int ksection_probes() {
+   return std::max(2, ksection_probes_setting());
+}
+
+/**
+ * @brief optimize_ksection_batch is a line optimization strategy which probes
+ *        K evenly spaced interior points of the bracket per iteration, as one
+ *        batch, and keeps the two intervals around the best one: the bracket
+ *        shrinks by (K+1)/2 per iteration. With an odd K the best probe is
+ *        the centre of the next bracket, and a CostCache only evaluates K-1
+ *        new points.
+ * @param init start value
+ * @param rng range to look in (same bracket as optimize_goldensectionsearch)
+ * @param batch_function cost function taking a vector of values and
+ *        returning the vector of their costs
+ * @param probes number K of interior points per iteration
+ * @return instance of T for which function is minimal
+ */
+template <typename T, typename BF>
+T optimize_ksection_batch(T init, T rng, BF batch_function,
+                          int probes = ksection_probes())
+{
+   probes = std::max(2, probes);
+   T sta = init - 0.382*rng;
+   T end = init + 0.618*rng;
+
+   // stop when neighbouring probes are closer than the golden-section
+   // tolerance
+   std::vector<T> xs(probes);
+   while ((end-sta)/(probes+1) > LINE_SEARCH_TOLERANCE) {
+      for (int i = 0; i < probes; ++i) {
+         xs[i] = sta + (end-sta)*(i+1)/(probes+1);
+      }
+      const std::vector<double> costs = batch_function(xs);
+      const int best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+      const T new_sta = best > 0 ? xs[best-1] : sta;
+      const T new_end = best < probes-1 ? xs[best+1] : end;
+      sta = new_sta;
+      end = new_end;
+   }
+
+   return (end+sta)/2;
+}
+
+/**
+ * @brief optimize_line runs the line search selected by line_search() on a
+ *        cost function of one value (the k-section probes are evaluated one
+ *        after another)
+ */
+template <typename T, typename F>
+T optimize_line(T init, T rng, F function)
+{
+   switch (line_search()) {
+   case K_SECTION:
+      return optimize_ksection_batch(init, rng, [&function](const std::vector<T> &xs) {
+         std::vector<double> costs;
+         for (const T &x : xs) {
+            costs.push_back(function(x));
+         }
+         return costs;
+      });
+   case BRENT:
+      return optimize_brent(init, rng, function);
+   default:
+      return optimize_goldensectionsearch(init, rng, function);
+   }
+}
+
+/**
+ * @brief optimize_line_batch runs the line search selected by line_search() on
+ *        a batch cost function (Brent submits batches of one value)
+ */
+template <typename T, typename BF>
+T optimize_line_batch(T init, T rng, BF batch_function)
+{
+   switch (line_search()) {
+   case K_SECTION:
+      return optimize_ksection_batch(init, rng, batch_function);
+   case BRENT:
+      return optimize_brent(init, rng, [&batch_function](T x) {
+         return batch_function(std::vector<T>{x})[0];
+      });
+   default:
+      return optimize_goldensectionsearch_batch(init, rng, batch_function);
+   }
+}
+
+/**
+ * @brief OptimizerStats counts the work of an optimizer run; together with
+ *        the evaluations of its CostCache it gives the cost of a line search
+ *        (or of a generation)
+ */
+struct OptimizerStats {
+   uint64_t sweeps = 0;        // passes over the search directions
+   uint64_t line_searches = 0;
+   uint64_t generations = 0;   // steps of the population optimizers
+
+   void print(const std::string &name, uint64_t evaluations,
+              std::ostream &os = std::cout) const {
+      if (generations != 0) {
+         os << name << ": " << generations << " generations, "
+            << (double)evaluations / generations
+            << " evaluations per generation" << std::endl;
+         return;
+      }
+      os << name << ": " << sweeps << " sweeps, " << line_searches
+         << " line searches, "
+         << (line_searches ? (double)evaluations / line_searches : 0.0)
+         << " evaluations per line search" << std::endl;
+   }
+};
+
+// Search directions of Powell: COORDINATE_DESCENT searches along the parameter
+// axes only; CONJUGATE_DIRECTIONS also replaces, after every sweep, the
+// direction of largest decrease with the net displacement of the sweep
+// (optimize_powell_conjugate_batch)
+enum PowellDirections { COORDINATE_DESCENT = 0, CONJUGATE_DIRECTIONS = 1 };
+
+// compile-time default of the Powell directions
+#ifndef REG_POWELL_DIRECTIONS
+#define REG_POWELL_DIRECTIONS COORDINATE_DESCENT
+#endif
+
+// the REG_POWELL environment variable ("coordinate" or "conjugate") takes
+// precedence over the compile-time default
+inline PowellDirections &powell_directions_setting() {
+   static PowellDirections directions = []() {
+      const char *env = std::getenv("REG_POWELL");
+      if (env && std::string(env) == "coordinate") return COORDINATE_DESCENT;
+      if (env && std::string(env) == "conjugate") return CONJUGATE_DIRECTIONS;
+      return (PowellDirections)REG_POWELL_DIRECTIONS;
+   }();
+   return directions;
+}
+
+// overrides the Powell directions at runtime
+inline void set_powell_directions(const PowellDirections directions) {
+   powell_directions_setting() = directions;
+}
+
+inline PowellDirections powell_directions() {
+   return powell_directions_setting();
+}
+
+/**
+ * @brief optimize_powell_conjugate_batch is Powell's direction-set method.
+ *        A sweep line-searches the n directions in turn, starting from the
+ *        parameter axes scaled by their ranges. Then, when the extrapolation
+ *        along the net displacement of the sweep promises a decrease, it
+ *        line-searches that displacement too and it becomes the newest
+ *        direction, replacing the one of largest decrease. Coupled parameters
+ *        (tx, ty and the angle) are then followed along their valley instead
+ *        of zig-zagging axis by axis. Line searches run in the direction
+ *        coordinate (the bracket of a scaled axis is the bracket of
+ *        optimize_powell), a step is only taken when it lowers the cost, and
+ *        the search stops when a sweep gains less than the tolerance of
+ *        optimize_powell.
+ * @param init range with the initial values, optimized values are stored in
+ *        there when the function returns
+ * @param rng range containing the ranges in which each parameter is optimized
+ * @param batch_cost_function cost function taking a vector of parameter
+ *        vectors and returning the vector of their costs
+ * @param max_sweeps stop after this many sweeps even if not converged
+ *        (0 = until convergence)
+ * @param stats when not null, counts the sweeps and line searches
+ */
+template <typename Iter, typename Bcf>
+void optimize_powell_conjugate_batch(std::pair<Iter, Iter> init,
+                                     std::pair<Iter, Iter> rng,
+                                     Bcf batch_cost_function,
+                                     int max_sweeps = 0,
+                                     OptimizerStats *stats = nullptr)
+{
+   using TPS = typename std::remove_reference<decltype(*init.first)>::type;
+   using Params = std::vector<TPS>;
+
+   const double eps = 0.0005;
+   const std::size_t n = init.second - init.first;
+   Params p(init.first, init.second);
+   std::vector<Params> directions(n, Params(n, 0));
+   for (std::size_t i = 0; i < n; ++i) {
+      directions[i][i] = rng.first[i];
+   }
+
+   auto along = [](const Params &from, const Params &direction, TPS lambda) {
+      Params to(from);
+      for (std::size_t i = 0; i < to.size(); ++i) {
+         to[i] += lambda*direction[i];
+      }
+      return to;
+   };
+   // minimizes along direction from p; p and cost move only on a decrease
+   auto minimize_along = [&](const Params &direction, double &cost) {
+      auto fn = [&](const std::vector<TPS> &lambdas) {
+         std::vector<Params> candidates;
+         for (const TPS lambda : lambdas) {
+            candidates.push_back(along(p, direction, lambda));
+         }
+         return batch_cost_function(candidates);
+      };
+      const TPS lambda = optimize_line_batch(TPS(0), TPS(1), fn);
+      const Params moved = along(p, direction, lambda);
+      const double moved_cost = batch_cost_function(std::vector<Params>{moved})[0];
+      if (stats) {
+         stats->line_searches++;
+      }
+      if (moved_cost < cost) {
+         p = moved;
+         cost = moved_cost;
+      }
+   };
+
+   double cost = batch_cost_function(std::vector<Params>{p})[0];
+   for (int sweep = 0; max_sweeps == 0 || sweep < max_sweeps; ++sweep) {
+      if (stats) {
+         stats->sweeps++;
+      }
+      const Params start = p;
+      const double start_cost = cost;
+      std::size_t largest = 0;
+      double largest_decrease = 0.0;
+      for (std::size_t i = 0; i < n; ++i) {
+         const double before = cost;
+         minimize_along(directions[i], cost);
+         if (before - cost > largest_decrease) {
+            largest_decrease = before - cost;
+            largest = i;
+         }
+      }
+      if (start_cost - cost <= eps) {
+         break;
+      }
+
+      // Powell's test: keep the directions when the extrapolated point
+      // 2 p - start is no better, or when the decrease was mostly along a
+      // single direction (replacing it would make the set degenerate)
+      Params displacement(n);
+      for (std::size_t i = 0; i < n; ++i) {
+         displacement[i] = p[i] - start[i];
+      }
+      const double extrapolated_cost =
+         batch_cost_function(std::vector<Params>{along(p, displacement, TPS(1))})[0];
+      if (extrapolated_cost < start_cost) {
+         const double t = 2.0*(start_cost - 2.0*cost + extrapolated_cost)
+                             *(start_cost - cost - largest_decrease)
+                             *(start_cost - cost - largest_decrease)
+                          - largest_decrease*(start_cost - extrapolated_cost)
+                                            *(start_cost - extrapolated_cost);
+         if (t < 0.0) {
+            minimize_along(displacement, cost);
+            directions[largest] = directions[n-1];
+            directions[n-1] = displacement;
+         }
+      }
+   }
+   std::copy(p.begin(), p.end(), init.first);
+}
+
 /**
  * @brief optimize_powell is a strategy to optimize a parameter space for a
- *        given cost function
+ *        given cost function, with the line search selected by line_search()
+ *        and the directions selected by powell_directions()
  * @param init range with the initial values, optimized values are stored in
  *        there when the function returns
  * @param rng range containing the ranges in which each parameter is optimized
  * @param cost_function cost function for which the parameters are optimized
+ * @param stats when not null, counts the sweeps and line searches
  */
 template <typename Iter, typename Cf>
 
@@ -98,16 +676,33 @@ template <typename Iter, typename Cf>
 
 void optimize_powell(std::pair<Iter, Iter> init,
                      std::pair<Iter, Iter> rng,
-                     Cf cost_function)
+                     Cf cost_function,
+                     OptimizerStats *stats = nullptr)
 {
 
    using TPS = typename std::remove_reference<decltype(*init.first)>::type;
 
+   if (powell_directions() == CONJUGATE_DIRECTIONS) {
+      // the candidates are evaluated one after another
+      auto batch = [&cost_function](const std::vector<std::vector<TPS>> &candidates) {
+         std::vector<double> costs;
+         for (std::vector<TPS> params : candidates) {
+            costs.push_back(cost_function(params.begin()));
+         }
+         return costs;
+      };
+      optimize_powell_conjugate_batch(init, rng, batch, 0, stats);
+      return;
+   }
+
    bool converged = false;
    const double eps = 0.0005;
    double last_mutualinf = 100000.0;
    while (!converged) {
       converged = true;
+      if (stats) {
+         stats->sweeps++;
+      }
       for (auto it = init.first; it != init.second; ++it) {
          std::size_t pos = it - init.first;
          auto curr_param = init.first[pos];
@@ -117,12 +712,84 @@ void optimize_powell(std::pair<Iter, Iter> init,
             init.first[pos] = p;
             return cost_function(init.first);
          };   
-         auto param_optimized = optimize_goldensectionsearch(curr_param, curr_rng, fn);
+         auto param_optimized = optimize_line(curr_param, curr_rng, fn);
+         if (stats) {
+            stats->line_searches++;
+         }
+         // the step is judged on the cost at the returned optimum (as in
+         // optimize_powell_batch), not at the last probe of the line search
+         init.first[pos] = param_optimized;
          auto curr_mutualinf = cost_function(init.first);
-         init.first[pos] = curr_param;
          if (last_mutualinf - curr_mutualinf > eps) {
             *it = param_optimized;
-            float temp = last_mutualinf;
+            last_mutualinf = curr_mutualinf;
+            converged = false;
+         } else {
+            *it = curr_param;
+         }
+      }
+   }
+}
+
+/**
+ * @brief optimize_powell_batch is optimize_powell for cost functions which
+ *        evaluate several parameter vectors at once: the probes of each line
+ *        search iteration are submitted as one batch, and the line search is
+ *        the one selected by line_search() (see optimize_line_batch; Brent
+ *        submits batches of one value)
+ * @param init range with the initial values, optimized values are stored in
+ *        there when the function returns
+ * @param rng range containing the ranges in which each parameter is optimized
+ * @param batch_cost_function cost function taking a vector of parameter
+ *        vectors and returning the vector of their costs
+ * @param max_sweeps stop after this many sweeps over the parameters even if
+ *        not converged (0 = until convergence)
+ * @param stats when not null, counts the sweeps and line searches
+ */
+template <typename Iter, typename Bcf>
+void optimize_powell_batch(std::pair<Iter, Iter> init,
+                           std::pair<Iter, Iter> rng,
+                           Bcf batch_cost_function,
+                           int max_sweeps = 0,
+                           OptimizerStats *stats = nullptr)
+{
+   using TPS = typename std::remove_reference<decltype(*init.first)>::type;
+   using Params = std::vector<TPS>;
+
+   if (powell_directions() == CONJUGATE_DIRECTIONS) {
+      optimize_powell_conjugate_batch(init, rng, batch_cost_function, max_sweeps, stats);
+      return;
+   }
+
+   bool converged = false;
+   const double eps = 0.0005;
+   double last_mutualinf = 100000.0;
+   for (int sweep = 0; !converged && (max_sweeps == 0 || sweep < max_sweeps); ++sweep) {
+      converged = true;
+      if (stats) {
+         stats->sweeps++;
+      }
+      for (auto it = init.first; it != init.second; ++it) {
+         std::size_t pos = it - init.first;
+         auto curr_param = init.first[pos];
+         auto curr_rng = rng.first[pos];
+         auto fn = [pos, init, &batch_cost_function](const std::vector<TPS> &ps)
+         {
+            std::vector<Params> candidates(ps.size(), Params(init.first, init.second));
+            for (std::size_t i = 0; i < ps.size(); ++i) {
+               candidates[i][pos] = ps[i];
+            }
+            return batch_cost_function(candidates);
+         };
+         auto param_optimized = optimize_line_batch(curr_param, curr_rng, fn);
+         if (stats) {
+            stats->line_searches++;
+         }
+         Params optimized(init.first, init.second);
+         optimized[pos] = param_optimized;
+         auto curr_mutualinf = batch_cost_function(std::vector<Params>{optimized})[0];
+         if (last_mutualinf - curr_mutualinf > eps) {
+            *it = param_optimized;
             last_mutualinf = curr_mutualinf;
             converged = false;
          } else {
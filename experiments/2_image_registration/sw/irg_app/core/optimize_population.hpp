@@ -0,0 +1,390 @@
+/******************************************
+* MIT License
+* 
+* Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+/***************************************************************
+*
+* population-based optimizers of the registration: every step submits a
+* whole generation of candidate transforms to a batch cost function, so that
+* several MI engines (or one batch pass over the reference volume) evaluate
+* them together
+*
+****************************************************************/
+#ifndef OPTIMIZE_POPULATION_HPP
+#define OPTIMIZE_POPULATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "optimize.hpp"
+
+// both optimizers work in coordinates normalized by the search ranges: a
+// parameter moves by its range for a unit step, and they stop when the
+// population has collapsed below LINE_SEARCH_TOLERANCE in these coordinates
+// (as the line searches of Powell do in the direction coordinate)
+
+// hard cap on the generations of a run
+const int POPULATION_MAX_GENERATIONS = 2000;
+
+// seed of the CMA-ES samples: a registration gives the same result from run to
+// run
+#ifndef CMAES_SEED
+#define CMAES_SEED 1234
+#endif
+
+/**
+ * @brief optimize_nelder_mead_batch is the Nelder-Mead simplex method where the
+ *        reflection, the expansion and the two contractions of the worst vertex
+ *        are submitted together as one batch: a generation costs one batch
+ *        (plus one for the rare shrinks) instead of up to three serial
+ *        evaluations, and the decision follows the usual rules on the four
+ *        costs.
+ * @param init range with the initial values, optimized values are stored in
+ *        there when the function returns
+ * @param rng range containing the ranges in which each parameter is optimized;
+ *        the initial simplex spans a quarter of each range
+ * @param batch_cost_function cost function taking a vector of parameter
+ *        vectors and returning the vector of their costs
+ * @param max_generations stop after this many generations (0 = until the
+ *        simplex collapses)
+ * @param stats when not null, counts the generations
+ */
+template <typename Iter, typename Bcf>
+void optimize_nelder_mead_batch(std::pair<Iter, Iter> init,
+                                std::pair<Iter, Iter> rng,
+                                Bcf batch_cost_function,
+                                int max_generations = 0,
+                                OptimizerStats *stats = nullptr)
+{
+   using TPS = typename std::remove_reference<decltype(*init.first)>::type;
+   using Params = std::vector<TPS>;
+
+   const std::size_t n = init.second - init.first;
+   const Params range(rng.first, rng.first + n);
+   if (max_generations <= 0 || max_generations > POPULATION_MAX_GENERATIONS) {
+      max_generations = POPULATION_MAX_GENERATIONS;
+   }
+
+   std::vector<Params> simplex(n + 1, Params(init.first, init.second));
+   for (std::size_t i = 0; i < n; ++i) {
+      simplex[i + 1][i] += 0.25 * range[i];
+   }
+   std::vector<double> costs = batch_cost_function(simplex);
+
+   // c + t (c - worst)
+   auto step = [n](const Params &c, const Params &worst, double t) {
+      Params p(n);
+      for (std::size_t i = 0; i < n; ++i) {
+         p[i] = c[i] + t * (c[i] - worst[i]);
+      }
+      return p;
+   };
+
+   std::vector<std::size_t> order(n + 1);
+   for (int generation = 0; generation < max_generations; ++generation) {
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&costs](std::size_t a, std::size_t b) { return costs[a] < costs[b]; });
+      const std::size_t best = order[0], second_worst = order[n - 1], worst = order[n];
+
+      double size = 0.0;
+      for (std::size_t v = 0; v <= n; ++v) {
+         for (std::size_t i = 0; i < n; ++i) {
+            size = std::max(size, std::fabs(simplex[v][i] - simplex[best][i]) / range[i]);
+         }
+      }
+      if (size <= LINE_SEARCH_TOLERANCE) {
+         break;
+      }
+      if (stats) {
+         stats->generations++;
+      }
+
+      Params centroid(n, 0);
+      for (std::size_t v = 0; v <= n; ++v) {
+         if (v == worst) continue;
+         for (std::size_t i = 0; i < n; ++i) {
+            centroid[i] += simplex[v][i] / n;
+         }
+      }
+      const std::vector<Params> moves{
+         step(centroid, simplex[worst], 1.0),   // reflection
+         step(centroid, simplex[worst], 2.0),   // expansion
+         step(centroid, simplex[worst], 0.5),   // outside contraction
+         step(centroid, simplex[worst], -0.5)}; // inside contraction
+      const std::vector<double> f = batch_cost_function(moves);
+
+      int accepted = -1;
+      if (f[0] < costs[best]) {
+         accepted = f[1] < f[0] ? 1 : 0;
+      } else if (f[0] < costs[second_worst]) {
+         accepted = 0;
+      } else if (f[0] < costs[worst]) {
+         accepted = f[2] <= f[0] ? 2 : -1;
+      } else {
+         accepted = f[3] < costs[worst] ? 3 : -1;
+      }
+
+      if (accepted >= 0) {
+         simplex[worst] = moves[accepted];
+         costs[worst] = f[accepted];
+         continue;
+      }
+      // shrink towards the best vertex, the new vertices as one batch
+      std::vector<Params> shrunk;
+      for (std::size_t v = 0; v <= n; ++v) {
+         if (v == best) continue;
+         for (std::size_t i = 0; i < n; ++i) {
+            simplex[v][i] = simplex[best][i] + 0.5 * (simplex[v][i] - simplex[best][i]);
+         }
+         shrunk.push_back(simplex[v]);
+      }
+      const std::vector<double> shrunk_costs = batch_cost_function(shrunk);
+      for (std::size_t v = 0, s = 0; v <= n; ++v) {
+         if (v != best) costs[v] = shrunk_costs[s++];
+      }
+   }
+
+   const std::size_t best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+   std::copy(simplex[best].begin(), simplex[best].end(), init.first);
+}
+
+/**
+ * @brief symmetric_eigen diagonalizes a symmetric matrix with cyclic Jacobi
+ *        rotations (the matrices of the optimizers are a few rows wide)
+ * @param a symmetric matrix, destroyed
+ * @param values eigenvalues
+ * @param vectors eigenvectors, as columns
+ */
+inline void symmetric_eigen(std::vector<std::vector<double>> a,
+                            std::vector<double> &values,
+                            std::vector<std::vector<double>> &vectors)
+{
+   const std::size_t n = a.size();
+   vectors.assign(n, std::vector<double>(n, 0.0));
+   for (std::size_t i = 0; i < n; ++i) {
+      vectors[i][i] = 1.0;
+   }
+   for (int sweep = 0; sweep < 50; ++sweep) {
+      double off = 0.0;
+      for (std::size_t p = 0; p < n; ++p) {
+         for (std::size_t q = p + 1; q < n; ++q) {
+            off += a[p][q] * a[p][q];
+         }
+      }
+      if (off < 1e-30) {
+         break;
+      }
+      for (std::size_t p = 0; p < n; ++p) {
+         for (std::size_t q = p + 1; q < n; ++q) {
+            if (a[p][q] == 0.0) continue;
+            // rotation that zeroes a[p][q]
+            const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+            const double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+            const double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+            for (std::size_t k = 0; k < n; ++k) {
+               const double akp = a[k][p], akq = a[k][q];
+               a[k][p] = c * akp - s * akq;
+               a[k][q] = s * akp + c * akq;
+            }
+            for (std::size_t k = 0; k < n; ++k) {
+               const double apk = a[p][k], aqk = a[q][k];
+               a[p][k] = c * apk - s * aqk;
+               a[q][k] = s * apk + c * aqk;
+            }
+            for (std::size_t k = 0; k < n; ++k) {
+               const double vkp = vectors[k][p], vkq = vectors[k][q];
+               vectors[k][p] = c * vkp - s * vkq;
+               vectors[k][q] = s * vkp + c * vkq;
+            }
+         }
+      }
+   }
+   values.resize(n);
+   for (std::size_t i = 0; i < n; ++i) {
+      values[i] = a[i][i];
+   }
+}
+
+/**
+ * @brief optimize_cmaes_batch is the covariance matrix adaptation evolution
+ *        strategy, (mu/mu_w, lambda)-CMA-ES with the default population
+ *        lambda = 4 + 3 ln n: every generation samples lambda transforms
+ *        around the mean, evaluates them as one batch, and moves the mean,
+ *        the step size and the covariance towards the best half. The samples
+ *        are drawn from a generator seeded with CMAES_SEED.
+ * @param init range with the initial values (the first mean), optimized values
+ *        (the best transform evaluated) are stored in there when the function
+ *        returns
+ * @param rng range containing the ranges in which each parameter is optimized;
+ *        the initial step size is 0.3 ranges
+ * @param batch_cost_function cost function taking a vector of parameter
+ *        vectors and returning the vector of their costs
+ * @param max_generations stop after this many generations (0 = until the step
+ *        size collapses)
+ * @param stats when not null, counts the generations
+ */
+template <typename Iter, typename Bcf>
+void optimize_cmaes_batch(std::pair<Iter, Iter> init,
+                          std::pair<Iter, Iter> rng,
+                          Bcf batch_cost_function,
+                          int max_generations = 0,
+                          OptimizerStats *stats = nullptr)
+{
+   using TPS = typename std::remove_reference<decltype(*init.first)>::type;
+   using Params = std::vector<TPS>;
+   using Matrix = std::vector<std::vector<double>>;
+
+   const std::size_t n = init.second - init.first;
+   const Params origin(init.first, init.second);
+   const Params range(rng.first, rng.first + n);
+   if (max_generations <= 0 || max_generations > POPULATION_MAX_GENERATIONS) {
+      max_generations = POPULATION_MAX_GENERATIONS;
+   }
+
+   // default strategy parameters (Hansen, "The CMA Evolution Strategy: A
+   // Tutorial")
+   const int lambda = 4 + (int)(3.0 * std::log((double)n));
+   const int mu = lambda / 2;
+   std::vector<double> weights(mu);
+   for (int i = 0; i < mu; ++i) {
+      weights[i] = std::log(mu + 0.5) - std::log(i + 1.0);
+   }
+   const double weight_sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+   double square_sum = 0.0;
+   for (double &w : weights) {
+      w /= weight_sum;
+      square_sum += w * w;
+   }
+   const double mu_eff = 1.0 / square_sum;
+   const double N = (double)n;
+   const double cc = (4.0 + mu_eff / N) / (N + 4.0 + 2.0 * mu_eff / N);
+   const double cs = (mu_eff + 2.0) / (N + mu_eff + 5.0);
+   const double c1 = 2.0 / ((N + 1.3) * (N + 1.3) + mu_eff);
+   const double cmu = std::min(1.0 - c1, 2.0 * (mu_eff - 2.0 + 1.0 / mu_eff) / ((N + 2.0) * (N + 2.0) + mu_eff));
+   const double damps = 1.0 + 2.0 * std::max(0.0, std::sqrt((mu_eff - 1.0) / (N + 1.0)) - 1.0) + cs;
+   const double chi_n = std::sqrt(N) * (1.0 - 1.0 / (4.0 * N) + 1.0 / (21.0 * N * N));
+
+   // state, in normalized coordinates (parameter = origin + range * y)
+   std::vector<double> mean(n, 0.0), ps(n, 0.0), pc(n, 0.0);
+   Matrix C(n, std::vector<double>(n, 0.0));
+   for (std::size_t i = 0; i < n; ++i) {
+      C[i][i] = 1.0;
+   }
+   double sigma = 0.3;
+
+   std::mt19937 generator(CMAES_SEED);
+   std::normal_distribution<double> normal(0.0, 1.0);
+
+   Params best(origin);
+   double best_cost = batch_cost_function(std::vector<Params>{origin})[0];
+
+   std::vector<double> D;
+   Matrix B;
+   for (int generation = 0; generation < max_generations; ++generation) {
+      // C = B diag(D^2) B^T
+      symmetric_eigen(C, D, B);
+      for (double &d : D) {
+         d = std::sqrt(std::max(d, 1e-30));
+      }
+      if (sigma * *std::max_element(D.begin(), D.end()) <= LINE_SEARCH_TOLERANCE) {
+         break;
+      }
+      if (stats) {
+         stats->generations++;
+      }
+
+      Matrix z(lambda, std::vector<double>(n)), y(lambda, std::vector<double>(n, 0.0));
+      std::vector<Params> candidates(lambda, Params(n));
+      for (int k = 0; k < lambda; ++k) {
+         for (std::size_t i = 0; i < n; ++i) {
+            z[k][i] = normal(generator);
+         }
+         for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+               y[k][i] += B[i][j] * D[j] * z[k][j];
+            }
+            candidates[k][i] = origin[i] + range[i] * (mean[i] + sigma * y[k][i]);
+         }
+      }
+      const std::vector<double> costs = batch_cost_function(candidates);
+
+      std::vector<int> order(lambda);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&costs](int a, int b) { return costs[a] < costs[b]; });
+      if (costs[order[0]] < best_cost) {
+         best_cost = costs[order[0]];
+         best = candidates[order[0]];
+      }
+
+      // weighted recombination of the best mu steps
+      std::vector<double> y_w(n, 0.0), z_w(n, 0.0);
+      for (int r = 0; r < mu; ++r) {
+         for (std::size_t i = 0; i < n; ++i) {
+            y_w[i] += weights[r] * y[order[r]][i];
+            z_w[i] += weights[r] * z[order[r]][i];
+         }
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+         mean[i] += sigma * y_w[i];
+      }
+
+      // evolution paths; C^(-1/2) y_w = B z_w
+      double ps_norm = 0.0;
+      for (std::size_t i = 0; i < n; ++i) {
+         double b_z = 0.0;
+         for (std::size_t j = 0; j < n; ++j) {
+            b_z += B[i][j] * z_w[j];
+         }
+         ps[i] = (1.0 - cs) * ps[i] + std::sqrt(cs * (2.0 - cs) * mu_eff) * b_z;
+         ps_norm += ps[i] * ps[i];
+      }
+      ps_norm = std::sqrt(ps_norm);
+      const bool h_sigma = ps_norm / std::sqrt(1.0 - std::pow(1.0 - cs, 2.0 * (generation + 1)))
+                           < (1.4 + 2.0 / (N + 1.0)) * chi_n;
+      for (std::size_t i = 0; i < n; ++i) {
+         pc[i] = (1.0 - cc) * pc[i] + (h_sigma ? std::sqrt(cc * (2.0 - cc) * mu_eff) : 0.0) * y_w[i];
+      }
+
+      // rank-one and rank-mu updates of the covariance, step-size adaptation
+      const double correction = h_sigma ? 0.0 : c1 * cc * (2.0 - cc);
+      for (std::size_t i = 0; i < n; ++i) {
+         for (std::size_t j = 0; j < n; ++j) {
+            double rank_mu = 0.0;
+            for (int r = 0; r < mu; ++r) {
+               rank_mu += weights[r] * y[order[r]][i] * y[order[r]][j];
+            }
+            C[i][j] = (1.0 - c1 - cmu + correction) * C[i][j] + c1 * pc[i] * pc[j] + cmu * rank_mu;
+         }
+      }
+      sigma *= std::exp((cs / damps) * (ps_norm / chi_n - 1.0));
+   }
+
+   std::copy(best.begin(), best.end(), init.first);
+}
+
+#endif // OPTIMIZE_POPULATION_HPP
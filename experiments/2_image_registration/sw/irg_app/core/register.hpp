@@ -62,15 +62,53 @@ Santambrogio]
 
 #ifdef HW_REG
 #include "../HAL/HardwareAbstractionLayer.h"
-#else
+#endif
+// software MI: the whole registration without HW_REG, the coarse pyramid
+// levels with it
 #include "../include/software_mi/software_mi.cpp"
+
+// software path: skip the all-zero background columns when building the joint
+// histograms (same MI as the dense pass)
+#ifndef SW_SPARSE_MI
+#define SW_SPARSE_MI 1
+#endif
+
+// joint-histogram bins (per axis) of the MI on the downsampled pyramid levels:
+// 256, 128, 64 or 32
+#ifndef SW_PYRAMID_BINS
+#define SW_PYRAMID_BINS J_HISTO_ROWS
 #endif
 
 #include "optimize.hpp"
+#include "optimize_population.hpp"
+#include <cstdlib>
+#include <functional>
+#include <string>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+// software path: evaluate the candidates of a batch in one fused pass over the
+// reference (1) or one at a time (0). The fused pass saves little: two rotated
+// candidates cost about 1.9x one candidate (pure translations 1.2x).
+#ifndef SW_BATCH_MI
+#define SW_BATCH_MI 0
+#endif
+
+// the SW_BATCH_MI environment variable ("1" or "0") takes precedence over the
+// compile-time default
+inline bool &sw_batch_mi_setting() {
+  static bool fused = []() {
+    if (const char *env = std::getenv("SW_BATCH_MI"))
+      return std::string(env) == "1";
+    return SW_BATCH_MI != 0;
+  }();
+  return fused;
+}
+
+// overrides the batch evaluation of the software registration at runtime
+inline void set_sw_batch_mi(const bool fused) { sw_batch_mi_setting() = fused; }
+
 /**
  * @brief The registration interface defines the signatures of a registration
  *        operation of a floating image to a reference image.
@@ -142,26 +180,68 @@ public:
     cast_mats_to_vector(buffer_flt, flt, DIMENSION, n_couples, 0, padding);
     std::vector<double> init{avg_tx, avg_ty, ang_rad};
     std::vector<double> rng{80.0, 80.0, 1.0, 1.0};
-    std::pair<std::vector<double>::iterator, std::vector<double>::iterator> o{
-        init.begin(), init.end()};
     // std::cout << "Running Powell optimization" << std::endl;
-    optimize_powell(o, {rng.begin(), rng.end()},
-                    std::bind(cost_function_3d, buffer_ref, buffer_flt,
-                              n_couples, padding, std::placeholders::_1));
+    // reference marginal, entropy and foreground are computed once and shared
+    // by every evaluation (background columns are skipped with SW_SPARSE_MI)
+    RegistrationContext context =
+        make_registration_context(buffer_ref, buffer_flt, DIMENSION, n_couples,
+                                  padding, J_HISTO_ROWS, SW_SPARSE_MI);
+    const std::vector<int> factors = registration_pyramid(DIMENSION);
+    if (!factors.empty())
+      register_pyramid(buffer_ref, buffer_flt, n_couples, padding, factors,
+                       init, rng);
+    // the probes of a line search are evaluated one at a time, or in one pass
+    // over the reference volume with SW_BATCH_MI; probes already evaluated
+    // (within the line-search tolerance) are taken from the cache of the
+    // current cost function
+    auto cost_function = [&](CostCache &cache, const VoxelSample *sample) {
+      return cached_batch_cost_function(
+          cache, std::bind(cost_function_3d_batch, std::ref(context), sample,
+                           std::placeholders::_1));
+    };
+    // early sweeps on a voxel subsample (far from the optimum the exact MI is
+    // not needed), then full resolution until convergence
+    const std::vector<double> schedule = sw_mi_schedule();
+    for (size_t sweep = 0; sweep < schedule.size(); sweep++) {
+      if (schedule[sweep] >= 1.0)
+        continue;
+      const VoxelSample sample =
+          build_voxel_sample(DIMENSION, schedule[sweep], SW_SAMPLE_SEED + sweep);
+      CostCache sampled_cache;
+      OptimizerStats sampled_stats;
+      optimize(init, rng, cost_function(sampled_cache, &sample), 1,
+               &sampled_stats);
+      sampled_cache.print_stats("Sampled sweep " + std::to_string(sweep));
+      sampled_stats.print("Sampled sweep " + std::to_string(sweep),
+                          sampled_cache.misses);
+    }
+    CostCache cache;
+    OptimizerStats stats;
+    optimize(init, rng, cost_function(cache, nullptr), 0, &stats);
+    cache.print_stats(optimizer_name());
+    stats.print(optimizer_name(), cache.misses);
     tx = init[0];
     ty = init[1];
     ang_rad = init[2];
     double mutual_inf =
         sw_registration_step_3d(buffer_ref, buffer_flt, registered_volume,
                                 n_couples, tx, ty, ang_rad, n_couples, padding);
+    final_params = {tx, ty, ang_rad};
+    final_mutual_inf = mutual_inf;
+    context.print_stats();
     auto time_end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = time_end - time_start;
     std::cout << "Final parameters: tx: " << tx << ", ty: " << ty
               << ", ang_rad: " << ang_rad << std::endl;
+    std::cout << "Final mutual information: " << mutual_inf << std::endl;
     std::cout << "Elapsed time for registration: " << elapsed.count()
               << " seconds" << std::endl;
     return elapsed.count();
   }
+
+  // transform and MI found by the last software registration
+  std::vector<double> final_params;
+  double final_mutual_inf = 0.0;
 #else
 
   double register_images_3d(std::vector<cv::Mat> &ref,
@@ -198,15 +278,32 @@ public:
     float ang_rad = atan2(avg_a21, avg_a11);
     std::vector<double> init{avg_tx, avg_ty, ang_rad};
     std::vector<double> rng{(double)rangeX, (double)rangeY, (double)AngZ};
-    std::pair<std::vector<double>::iterator, std::vector<double>::iterator> o{
-        init.begin(), init.end()};
+    // coarse levels on the CPU, only the full resolution on the accelerator
+    const std::vector<int> factors = registration_pyramid(DIMENSION);
+    if (!factors.empty()) {
+      const int depth = ref.size();
+      std::vector<uint8_t> buffer_ref((size_t)DIMENSION * DIMENSION * depth);
+      std::vector<uint8_t> buffer_flt((size_t)DIMENSION * DIMENSION * depth);
+      cast_mats_to_vector(buffer_ref.data(), ref, DIMENSION, depth, 0, 0);
+      cast_mats_to_vector(buffer_flt.data(), flt, DIMENSION, depth, 0, 0);
+      register_pyramid(buffer_ref.data(), buffer_flt.data(), depth, 0, factors,
+                       init, rng);
+    }
     // std::chrono::duration<double> before_powell =
     //     std::chrono::high_resolution_clock::now() - time_start;
     // std::cout << "Time before Powell optimization: " << before_powell.count()
     //           << " seconds" << std::endl;
-    optimize_powell(
-        o, {rng.begin(), rng.end()},
-        std::bind(cost_function_3d, std::ref(board), std::placeholders::_1));
+    // every cache miss is one warp and MI round trip on the accelerator
+    CostCache cache;
+    OptimizerStats stats;
+    optimize_serial(init, rng,
+                    cached_cost_function<std::vector<double>::iterator>(
+                        cache, init.size(),
+                        std::bind(cost_function_3d, std::ref(board),
+                                  std::placeholders::_1)),
+                    &stats);
+    cache.print_stats(optimizer_name());
+    stats.print(optimizer_name(), cache.misses);
     tx = init[0];
     ty = init[1];
     ang_rad = init[2];
@@ -227,6 +324,48 @@ public:
 
 #endif
 
+protected:
+  // cost function of the software registration: costs of a vector of
+  // candidate transforms (tx, ty, ang_rad)
+  using BatchCostFunction = std::function<std::vector<double>(
+      const std::vector<std::vector<double>> &)>;
+
+  /**
+   * @brief optimize searches the transform of minimum cost, starting from
+   *        params, with Powell's method; the strategies derived from
+   *        mutualinformation override it to use another optimizer
+   * @param params initial transform, replaced by the optimized one
+   * @param ranges search range of each parameter
+   * @param max_sweeps stop after this many Powell sweeps (0 = until
+   *        convergence)
+   * @param stats counts the work of the optimizer
+   */
+  virtual void optimize(std::vector<double> &params,
+                        std::vector<double> ranges,
+                        const BatchCostFunction &cost, int max_sweeps,
+                        OptimizerStats *stats) {
+    optimize_powell_batch(std::make_pair(params.begin(), params.end()),
+                          std::make_pair(ranges.begin(), ranges.end()), cost,
+                          max_sweeps, stats);
+  }
+
+#ifdef HW_REG
+  // cost function of the accelerator: one transform at a time
+  using CostFunction = std::function<double(std::vector<double>::iterator)>;
+
+  // optimize for the cost function of the accelerator
+  virtual void optimize_serial(std::vector<double> &params,
+                               std::vector<double> ranges,
+                               const CostFunction &cost,
+                               OptimizerStats *stats) {
+    optimize_powell(std::make_pair(params.begin(), params.end()),
+                    std::make_pair(ranges.begin(), ranges.end()), cost, stats);
+  }
+#endif
+
+  // name of the optimizer in the statistics
+  virtual std::string optimizer_name() const { return "Powell"; }
+
 private:
 #ifdef HW_REG
   static double cost_function_3d(HardwareAbstractionLayer &board,
@@ -240,20 +379,72 @@ private:
     // std::cout<<"Executed HW STEP: Partial MI: "<<val << std::endl;
     return val;
   }
-#else
-  static double cost_function_3d(uint8_t *ref, uint8_t *flt, int depth,
-                                 int padding,
-                                 std::vector<double>::iterator affine_params) {
-    const double tx = affine_params[0];
-    const double ty = affine_params[1];
-    const double ang = affine_params[2];
-    double partial_mi = exp(
-        -sw_registration_step_3d(ref, flt, 512, tx, ty, ang, depth, padding));
-    // std::cout<<"Executed SW STEP: Partial MI: "<<partial_mi << std::endl;
+#endif
 
+  static std::vector<double>
+  cost_function_3d_batch(RegistrationContext &context,
+                         const VoxelSample *sample,
+                         const std::vector<std::vector<double>> &candidates) {
+    // integer translations, as in the TX/TY parameters of
+    // sw_registration_step_3d
+    std::vector<rigid_transform> transforms;
+    for (const auto &affine_params : candidates) {
+      transforms.push_back({(float)(int)affine_params[0],
+                            (float)(int)affine_params[1],
+                            (float)affine_params[2]});
+    }
+    std::vector<double> partial_mi;
+    if (sw_batch_mi_setting()) {
+      partial_mi = sw_mutual_information_batch(context, transforms, sample);
+    } else {
+      for (const rigid_transform &transform : transforms)
+        partial_mi.push_back(
+            sw_mutual_information_batch(context, {transform}, sample)[0]);
+    }
+    for (auto &mi : partial_mi) {
+      mi = exp(-mi);
+    }
     return partial_mi;
   }
-#endif
+
+  /**
+   * @brief register_pyramid runs the optimizer on the downsampled levels of the
+   *        registration pyramid, coarsest first. Translations and their ranges
+   *        are scaled by the level factor and every level starts from the
+   *        estimate of the previous one.
+   * @param init initial transform (full-resolution pixels), replaced by the
+   *        estimate of the finest level
+   * @param rng search ranges, narrowed to what is left for the full resolution
+   */
+  void register_pyramid(const uint8_t *ref, const uint8_t *flt, int depth,
+                        int padding, const std::vector<int> &factors,
+                        std::vector<double> &init, std::vector<double> &rng) {
+    std::vector<PyramidLevel> levels =
+        build_pyramid(ref, flt, DIMENSION, depth + padding, factors);
+    for (PyramidLevel &level : levels) {
+      const double f = level.factor;
+      std::vector<double> params{init[0] / f, init[1] / f, init[2]};
+      std::vector<double> ranges{rng[0] / f, rng[1] / f, rng[2]};
+      RegistrationContext context = make_registration_context(
+          level.ref.data(), level.flt.data(), level.size, depth, padding,
+          SW_PYRAMID_BINS, SW_SPARSE_MI);
+      CostCache cache;
+      optimize(params, ranges,
+               cached_batch_cost_function(
+                   cache, std::bind(cost_function_3d_batch, std::ref(context),
+                                    nullptr, std::placeholders::_1)),
+               0, nullptr);
+      init = {params[0] * f, params[1] * f, params[2]};
+      // finer levels only have to recover the integer translation step of
+      // this one
+      rng[0] = rng[1] = 4.0 * f;
+      rng[2] /= 2.0;
+      std::cout << "Pyramid level " << level.factor << "x (" << level.size
+                << "x" << level.size << "): " << context.evaluations
+                << " evaluations (" << cache.hits << " cache hits), tx: " << init[0] << ", ty: " << init[1]
+                << ", ang_rad: " << init[2] << std::endl;
+    }
+  }
 
   static void estimate_initial(cv::Mat ref, cv::Mat flt, double &tx, double &ty,
                                double &a11, double &a12, double &a21,
@@ -300,4 +491,111 @@ private:
   }
 };
 
+/**
+ * @brief The population strategies replace Powell in the mutual information
+ *        registration with an optimizer which submits a whole generation of
+ *        candidate transforms per step: on the CPU a generation is one batch
+ *        pass over the reference volume, and several MI engines can evaluate
+ *        it concurrently, while Powell keeps one busy. On the accelerator
+ *        path the candidates are evaluated one after another.
+ */
+class populationregistration : public mutualinformation {
+protected:
+  // generations allowed per Powell sweep when the sweeps are limited (the
+  // sampled sweeps): about the evaluations of one sweep
+  static const int GENERATIONS_PER_SWEEP = 10;
+
+#ifdef HW_REG
+  void optimize_serial(std::vector<double> &params, std::vector<double> ranges,
+                       const CostFunction &cost,
+                       OptimizerStats *stats) override {
+    optimize(
+        params, ranges,
+        [&cost](const std::vector<std::vector<double>> &candidates) {
+          std::vector<double> costs;
+          for (std::vector<double> candidate : candidates) {
+            costs.push_back(cost(candidate.begin()));
+          }
+          return costs;
+        },
+        0, stats);
+  }
+#endif
+};
+
+/**
+ * @brief The neldermead strategy optimizes with a Nelder-Mead simplex whose
+ *        reflection, expansion and contractions are evaluated as one batch
+ */
+class neldermead : public populationregistration {
+protected:
+  void optimize(std::vector<double> &params, std::vector<double> ranges,
+                const BatchCostFunction &cost, int max_sweeps,
+                OptimizerStats *stats) override {
+    optimize_nelder_mead_batch(std::make_pair(params.begin(), params.end()),
+                               std::make_pair(ranges.begin(), ranges.end()),
+                               cost, max_sweeps * GENERATIONS_PER_SWEEP, stats);
+  }
+
+  std::string optimizer_name() const override { return "Nelder-Mead"; }
+};
+
+/**
+ * @brief The cmaes strategy optimizes with CMA-ES, one batch of 4 + 3 ln n
+ *        sampled transforms per generation
+ */
+class cmaes : public populationregistration {
+protected:
+  void optimize(std::vector<double> &params, std::vector<double> ranges,
+                const BatchCostFunction &cost, int max_sweeps,
+                OptimizerStats *stats) override {
+    optimize_cmaes_batch(std::make_pair(params.begin(), params.end()),
+                         std::make_pair(ranges.begin(), ranges.end()), cost,
+                         max_sweeps * GENERATIONS_PER_SWEEP, stats);
+  }
+
+  std::string optimizer_name() const override { return "CMA-ES"; }
+};
+
+/**
+ * @brief The identity strategy does not register: the floating volume is
+ *        returned as it is (identity transform), as a baseline for the time
+ *        and the alignment of the other strategies
+ */
+class identity : public registration {
+public:
+#ifndef HW_REG
+  double register_images_3d(std::vector<cv::Mat> &ref,
+                            std::vector<cv::Mat> &flt, int n_couples,
+                            int padding, int rangeX, int rangeY, float AngZ,
+                            uint8_t *registered_volume) override {
+    std::chrono::high_resolution_clock::time_point time_start =
+        std::chrono::high_resolution_clock::now();
+    cast_mats_to_vector(registered_volume, flt, DIMENSION, n_couples, 0,
+                        padding);
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - time_start;
+    std::cout << "Final parameters: tx: 0, ty: 0, ang_rad: 0" << std::endl;
+    std::cout << "Elapsed time for registration: " << elapsed.count()
+              << " seconds" << std::endl;
+    return elapsed.count();
+  }
+#else
+  double register_images_3d(std::vector<cv::Mat> &ref,
+                            std::vector<cv::Mat> &flt,
+                            HardwareAbstractionLayer &board, int rangeX,
+                            int rangeY, float AngZ) override {
+    std::chrono::high_resolution_clock::time_point time_start =
+        std::chrono::high_resolution_clock::now();
+    board.transform_volume(0.0, 0.0, 0.0);
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - time_start;
+    std::cout << "Final parameters: tx: 0, ty: 0, ang_rad: 0" << std::endl;
+    std::cout << "Elapsed time for registration: " << elapsed.count()
+              << " seconds" << std::endl;
+    return elapsed.count();
+  }
+#endif
+};
+
 #endif // REGISTER_HPP
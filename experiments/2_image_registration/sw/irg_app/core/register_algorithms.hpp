@@ -71,9 +71,10 @@ class register_algorithms
 
    public:
       /**
-       * @brief pick returns the fusion algorithm for the given name
-       * @param name identifying name / key of the fusion strategy
-       * @return instance of the fusion strategy
+       * @brief pick returns the registration algorithm for the given name
+       *        (unknown names fall back to "mutualinformation")
+       * @param name identifying name / key of the registration strategy
+       * @return instance of the registration strategy
        */
       static std::unique_ptr<registration> pick(std::string name)
       {
@@ -86,7 +87,22 @@ class register_algorithms
          {
             return std::make_unique<mutualinformation>();
          }
-         
+
+         if (name == "neldermead")
+         {
+            return std::make_unique<neldermead>();
+         }
+
+         if (name == "cmaes")
+         {
+            return std::make_unique<cmaes>();
+         }
+
+         if (name == "identity")
+         {
+            return std::make_unique<identity>();
+         }
+
          return nullptr;
       }
 
@@ -107,6 +123,8 @@ class register_algorithms
 const std::vector<std::string> register_algorithms::algorithms
 {
    "mutualinformation",
+   "neldermead",
+   "cmaes",
    "identity"
 };
 
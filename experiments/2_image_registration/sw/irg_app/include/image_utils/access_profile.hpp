@@ -0,0 +1,150 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Access-tracking policies of the column warp engine (the Tracker parameter of transform_rows). The engine
+// reports every source column it reads and the boundaries of every output row; with NoAccessTracking all the
+// calls are empty and compile away.
+struct NoAccessTracking {
+    void reset(int /* SIZE */, int /* LAYERS */, int /* MAX_READS */) {}
+    void begin_row() {}
+    void read_column(int /* offset */) {}
+    void end_row() {}
+};
+
+// Source-access profile of one warp thread, to size on-chip buffers:
+//  - reuse distance of each column read: number of distinct source columns read since the previous read of the
+//    same column (LRU stack distance), in power-of-two buckets (bucket b > 0 holds [2^(b-1), 2^b)),
+//    first reads are counted apart as cold;
+//  - row span of each output row: number of source rows between the lowest and highest one it reads.
+// The stack distances are computed with a Fenwick tree over the read times, O(log reads) per read.
+struct AccessProfile {
+    static constexpr int REUSE_BUCKETS = 33;
+
+    int SIZE = 0;
+    int LAYERS = 0;
+    uint64_t reads = 0;
+    uint64_t sequential = 0; // reads starting right after the end of the previous one
+    uint64_t cold = 0;
+    std::vector<uint64_t> reuse_distance; // REUSE_BUCKETS buckets
+    std::vector<uint64_t> row_span;       // SIZE + 1 entries, [0] for rows that read nothing
+
+    void reset(const int SIZE, const int LAYERS, const int MAX_READS) {
+        this->SIZE = SIZE;
+        this->LAYERS = LAYERS;
+        reads = sequential = cold = 0;
+        reuse_distance.assign(REUSE_BUCKETS, 0);
+        row_span.assign(SIZE + 1, 0);
+        last_read.assign((size_t)SIZE * SIZE, 0);
+        latest.assign((size_t)MAX_READS + 1, 0);
+        time = 0;
+        previous_end = -1;
+    }
+
+    void begin_row() {
+        row_min = INT_MAX;
+        row_max = -1;
+    }
+
+    void read_column(const int offset) {
+        const int column = offset / LAYERS; // row * SIZE + col in the source plane
+        const int row = column / SIZE;
+        row_min = std::min(row_min, row);
+        row_max = std::max(row_max, row);
+
+        reads++;
+        sequential += offset == previous_end;
+        previous_end = offset + LAYERS;
+
+        time++;
+        if ((size_t)time >= latest.size()) grow();
+        const int previous = last_read[column];
+        if (previous == 0) {
+            cold++;
+        } else {
+            const uint64_t distance = prefix(time - 1) - prefix(previous);
+            reuse_distance[distance == 0 ? 0 : 64 - __builtin_clzll(distance)]++;
+            add(previous, -1);
+        }
+        add(time, 1);
+        last_read[column] = time;
+    }
+
+    void end_row() {
+        row_span[row_max < 0 ? 0 : row_max - row_min + 1]++;
+    }
+
+private:
+    std::vector<int> last_read; // per source column, time of its latest read (0 = never)
+    std::vector<int> latest;    // Fenwick tree: 1 at the times that are the latest read of their column
+    int time = 0;
+    int previous_end = -1;
+    int row_min = INT_MAX;
+    int row_max = -1;
+
+    // more reads than MAX_READS: rebuild a tree twice as large from the latest read times
+    void grow() {
+        latest.assign(2 * latest.size(), 0);
+        for (const int t : last_read)
+            if (t != 0) add(t, 1);
+    }
+
+    void add(int t, const int delta) {
+        for (; t < (int)latest.size(); t += t & -t) latest[t] += delta;
+    }
+
+    uint64_t prefix(int t) const {
+        uint64_t sum = 0;
+        for (; t > 0; t -= t & -t) sum += latest[t];
+        return sum;
+    }
+};
+
+// Writes the profiles (one per warp thread) as csv: thread,histogram,bin,count. Reuse-distance bins are the
+// lower bound of each bucket ("cold" for first reads), row-span bins the number of source rows.
+inline bool write_access_profiles(const std::vector<AccessProfile> &profiles, const std::string &path) {
+    std::ofstream csv(path);
+    if (!csv) return false;
+    csv << "thread,histogram,bin,count\n";
+    for (size_t t = 0; t < profiles.size(); t++) {
+        const AccessProfile &profile = profiles[t];
+        csv << t << ",reads,total," << profile.reads << "\n";
+        csv << t << ",reads,sequential," << profile.sequential << "\n";
+        csv << t << ",reuse_distance,cold," << profile.cold << "\n";
+        for (int b = 0; b < AccessProfile::REUSE_BUCKETS; b++)
+            if (profile.reuse_distance[b] != 0)
+                csv << t << ",reuse_distance," << (b == 0 ? 0 : 1ull << (b - 1)) << "," << profile.reuse_distance[b] << "\n";
+        for (size_t span = 0; span < profile.row_span.size(); span++)
+            if (profile.row_span[span] != 0)
+                csv << t << ",row_span," << span << "," << profile.row_span[span] << "\n";
+    }
+    return true;
+}
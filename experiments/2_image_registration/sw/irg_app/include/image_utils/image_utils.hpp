@@ -24,10 +24,20 @@ SOFTWARE.
 
 #pragma once
 #include "opencv2/opencv.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include <unordered_map>
+#include <memory>
+#include <vector>
+#include "../thread_utils/thread_utils.hpp"
+#include "access_profile.hpp"
+#include "shear_warp.hpp"
+#include "rigid_warp_xy_plane/rigidWarpFunctor.hpp" // RigidWarp, shared with the HIP kernel
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
-#define TRACK_READS                 
 #define COMPILE_WITHOUT_DCMTK       
 
 #ifndef COMPILE_WITHOUT_DCMTK
@@ -47,9 +57,6 @@ int read_volume_from_file(uint8_t *volume, const int SIZE, const int N_COUPLES,
 void write_volume_to_file(uint8_t *volume, const int SIZE, const int N_COUPLES, const int BORDER_PADDING, const int DEPTH_PADDING, const std::string &path);
 
 
-uint8_t track_reads(uint8_t *mem, const int index, float *ratio = NULL);
-void get_cache_stats(int &hits, int &misses, int &size);
-void reset_cache_stats();
 
 
 void transform_volume(
@@ -60,70 +67,87 @@ void transform_volume(
     const float ANG,
     const int SIZE,
     const int LAYERS,
-    const bool bilinear_interpolation = MODE_NEAREST
+    const bool bilinear_interpolation = MODE_NEAREST,
+    int N_THREADS = sw_num_threads()
 );
 
+void transform_volume_voxelwise(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX,
+    const float TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    const bool bilinear_interpolation = MODE_NEAREST
+);
 
-int cache_hits = 0;
-int cache_misses = 0;
-int cache_size = 0;
-
-void get_cache_stats(int &hits, int &misses, int &size) {
-    hits = cache_hits;
-    misses = cache_misses;
-    size = cache_size;
-}
-
-void reset_cache_stats() {
-    cache_hits = 0;
-    cache_misses = 0;
-    cache_size = 0;
-}
-
-#define CACHE_STRATEGY_SIGNATURE uint8_t *source, int Pi, int Pj, int i, int j, int k, int index, int SIZE, int LAYERS, bool can_overwrite
-typedef uint8_t (*CacheStrategy)(CACHE_STRATEGY_SIGNATURE);
-#define NO_CACHING NULL
-
-uint8_t read_from_cache(CACHE_STRATEGY_SIGNATURE, CacheStrategy cache_strategy = NO_CACHING) {
-    if (index == -1) return 0;
-    if (k > 0 || cache_strategy == NO_CACHING) return source[index];
+void transform_volume_fixed_point(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX,
+    const float TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    int N_THREADS = sw_num_threads()
+);
 
-    return cache_strategy(source, Pi, Pj, i, j, k, index, SIZE, LAYERS, can_overwrite);
-}
 
-// macro for the function signature of a caching strategy with name X
-#define CACHE_STRATEGY_DEF(X) uint8_t cache_strategy_##X(CACHE_STRATEGY_SIGNATURE)
-#define CACHE_STRATEGY(X) &cache_strategy_##X
+// rows of the source kept by the line buffer (power of 2) and widest row it can hold
+#ifndef LINE_BUFFER_ROWS
+#define LINE_BUFFER_ROWS 4
+#endif
+#ifndef LINE_BUFFER_MAX_SIZE
+#define LINE_BUFFER_MAX_SIZE 1024
+#endif
 
+// Read cache for the k = 0 plane, like that paper (https://sfat.massey.ac.nz/research/centres/crisp/pdfs/2004_DELTA_126.pdf):
+// a ring of LINE_BUFFER_ROWS source rows, source row Pj lives in slot Pj % LINE_BUFFER_ROWS.
+// Every entry remembers the row it was filled from, so a slot only hits for the row it currently holds.
+// Fixed size and owned by the caller (no heap, no globals): use one per thread.
+// Only the voxelwise reference path (transform_volume_voxelwise, transform_bilinear) and warp_cache_benchmark
+// read through it; the column engine of transform_volume reads whole source columns directly.
+struct LineBuffer {
+    static_assert((LINE_BUFFER_ROWS & (LINE_BUFFER_ROWS - 1)) == 0, "LINE_BUFFER_ROWS must be a power of 2");
+
+    int tags[LINE_BUFFER_ROWS][LINE_BUFFER_MAX_SIZE];
+    uint8_t values[LINE_BUFFER_ROWS][LINE_BUFFER_MAX_SIZE];
+    long hits = 0;
+    long misses = 0;
+
+    LineBuffer() { reset(); }
+
+    void reset() {
+        std::fill(&tags[0][0], &tags[0][0] + LINE_BUFFER_ROWS * LINE_BUFFER_MAX_SIZE, -1);
+        hits = 0;
+        misses = 0;
+    }
 
-// ---------- cahing strategies ----------
+    // index is the offset of (Pi, Pj, 0) in source; rows wider than the buffer bypass it
+    uint8_t read(const uint8_t *source, const int Pi, const int Pj, const int index) {
+        if (Pi >= LINE_BUFFER_MAX_SIZE) return source[index];
 
-// just for testing
-// uint8_t cache_strategy_dummy(uint8_t *source, int i, int j, int k, int index, int SIZE, int LAYERS, bool can_overwrite) {
-CACHE_STRATEGY_DEF(dummy) {
-    return source[index];
-}
+        const int slot = Pj & (LINE_BUFFER_ROWS - 1);
+        if (tags[slot][Pi] == Pj) {
+            hits++;
+            return values[slot][Pi];
+        }
 
-// like that paper (https://sfat.massey.ac.nz/research/centres/crisp/pdfs/2004_DELTA_126.pdf)
-CACHE_STRATEGY_DEF(GribbonBailey) {
-    struct CacheElem {
-        int y;
-        uint8_t value;
-    };
-    static std::unordered_map<int, CacheElem> cache;
+        misses++;
+        tags[slot][Pi] = Pj;
+        values[slot][Pi] = source[index];
+        return values[slot][Pi];
+    }
+};
 
-    bool hit = (cache.find(Pi) != cache.end() && cache[Pi].y == Pj);
+#define NO_CACHING NULL
 
-    if (hit) {
-        cache_hits++;
-        return cache[Pi].value;
-    }
+uint8_t read_from_cache(uint8_t *source, int Pi, int Pj, int k, int index, LineBuffer *cache = NO_CACHING) {
+    if (index == -1) return 0;
+    if (k > 0 || cache == NO_CACHING) return source[index];
 
-    cache_misses++;
-    uint8_t new_value = source[index];
-    if (can_overwrite)
-        cache[Pi] = {Pj, new_value};
-    return new_value;
+    return cache->read(source, Pi, Pj, index);
 }
 
 template <class T>
@@ -150,11 +174,7 @@ inline uint8_t transform_nearest_neighbour(
     int old_index = transform_coords(SIZE, LAYERS, TX, TY, ANG, i, j, k);
 
     // read pixel from input volume
-    #ifndef TRACK_READS
     uint8_t pixel = (old_index != -1 ? volume_src[old_index] : 0);
-    #else
-    uint8_t pixel = (old_index != -1 ? track_reads(volume_src, old_index) : 0); // count sequential reads for stas
-    #endif
 
     return pixel;
 }
@@ -165,11 +185,13 @@ inline bool is_out_of_bounds(const int SIZE, const int LAYERS, const float i, co
             j < 0 || j >= SIZE);
 }
 
+// cache = NO_CACHING reads the source directly; threads sharing a LineBuffer must not run concurrently
 inline uint8_t transform_bilinear(
     uint8_t *volume_src,
     const float TX, const float TY, const float ANG,
     const int SIZE, const int LAYERS,
-    const int i, const int j, const int k
+    const int i, const int j, const int k,
+    LineBuffer *cache = NO_CACHING
 ) {
     // compute source position (transform [i,j] coordinates)
     const float P_i = (i-SIZE/2.f - TX)*std::cos(ANG) - (j-SIZE/2.f - TY)*std::sin(ANG) + (SIZE/2.f);
@@ -188,10 +210,10 @@ inline uint8_t transform_bilinear(
     const int Q22_index = (!is_out_of_bounds(SIZE, LAYERS, P_right, P_bottom) ? compute_buffer_offset<int>(SIZE, LAYERS, P_right, P_bottom, k) : -1); // bottom-right
 
     // retrieve values of the 4 pixels (top-left, top-right, bottom-left, bottom-right)
-    const float Q11_val = (float)read_from_cache(volume_src, P_left,  P_top,    i, j, k, Q11_index, SIZE, LAYERS, true, CACHE_STRATEGY(GribbonBailey));
-    const float Q12_val = (float)read_from_cache(volume_src, P_right, P_top,    i, j, k, Q12_index, SIZE, LAYERS, true, CACHE_STRATEGY(GribbonBailey));
-    const float Q21_val = (float)read_from_cache(volume_src, P_left,  P_bottom, i, j, k, Q21_index, SIZE, LAYERS, true, CACHE_STRATEGY(GribbonBailey));
-    const float Q22_val = (float)read_from_cache(volume_src, P_right, P_bottom, i, j, k, Q22_index, SIZE, LAYERS, true, CACHE_STRATEGY(GribbonBailey));
+    const float Q11_val = (float)read_from_cache(volume_src, P_left,  P_top,    k, Q11_index, cache);
+    const float Q12_val = (float)read_from_cache(volume_src, P_right, P_top,    k, Q12_index, cache);
+    const float Q21_val = (float)read_from_cache(volume_src, P_left,  P_bottom, k, Q21_index, cache);
+    const float Q22_val = (float)read_from_cache(volume_src, P_right, P_bottom, k, Q22_index, cache);
 
     // projections of P_i and P_j on the x-axis and y-axis, in the box Q11-Q12-Q21-Q22
     const float R_i = P_i - P_left; // fractional part of P_i
@@ -207,7 +229,660 @@ inline uint8_t transform_bilinear(
     return pixel;
 }
 
+// ---------- column engine ----------
+// The warp is in-plane, so all the LAYERS voxels of an output column (i, j) share the source position:
+// it is mapped once per column and the contiguous depth columns of the source are blended (or copied) as a whole.
+
+// offsets of the 4 source columns around the source position of output column (i, j) (-1 when out of
+// bounds) and the bilinear weights; same arithmetic as transform_bilinear
+struct BilinearColumn {
+    int q11, q12, q21, q22; // top-left, top-right, bottom-left, bottom-right
+    float r_i, r_j;
+};
+
+// bilinear column around source position (P_i, P_j)
+inline BilinearColumn bilinear_column_at(const float P_i, const float P_j, const int SIZE, const int LAYERS) {
+    const float P_left = std::floor(P_i);
+    const float P_right = std::ceil(P_i);
+    const float P_top = std::floor(P_j);
+    const float P_bottom = std::ceil(P_j);
+
+    BilinearColumn column;
+    column.q11 = (!is_out_of_bounds(SIZE, LAYERS, P_left, P_top)     ? compute_buffer_offset<int>(SIZE, LAYERS, P_left,  P_top,    0) : -1);
+    column.q12 = (!is_out_of_bounds(SIZE, LAYERS, P_right, P_top)    ? compute_buffer_offset<int>(SIZE, LAYERS, P_right, P_top,    0) : -1);
+    column.q21 = (!is_out_of_bounds(SIZE, LAYERS, P_left, P_bottom)  ? compute_buffer_offset<int>(SIZE, LAYERS, P_left,  P_bottom, 0) : -1);
+    column.q22 = (!is_out_of_bounds(SIZE, LAYERS, P_right, P_bottom) ? compute_buffer_offset<int>(SIZE, LAYERS, P_right, P_bottom, 0) : -1);
+    column.r_i = P_i - P_left;
+    column.r_j = P_j - P_top;
+    return column;
+}
+
+// bilinear_column_at for a source position whose 4 neighbours are in bounds (no bounds checks)
+inline BilinearColumn bilinear_column_inside(const float P_i, const float P_j, const int SIZE, const int LAYERS) {
+    const int left = (int)std::floor(P_i);
+    const int right = (int)std::ceil(P_i);
+    const int top = (int)std::floor(P_j);
+    const int bottom = (int)std::ceil(P_j);
+
+    BilinearColumn column;
+    column.q11 = top * SIZE * LAYERS + left * LAYERS;
+    column.q12 = top * SIZE * LAYERS + right * LAYERS;
+    column.q21 = bottom * SIZE * LAYERS + left * LAYERS;
+    column.q22 = bottom * SIZE * LAYERS + right * LAYERS;
+    column.r_i = P_i - left;
+    column.r_j = P_j - top;
+    return column;
+}
+
+// source position of output column (i, j) for the bilinear warp
+inline void bilinear_position(
+    const float TX, const float TY, const float COS, const float SIN,
+    const int SIZE,
+    const int i, const int j,
+    float &P_i, float &P_j
+) {
+    const RigidWarp warp{SIZE, 1, COS, SIN, TX, TY, true};
+    warp.bilinear_source(i, j, P_i, P_j);
+}
+
+inline BilinearColumn bilinear_column(
+    const float TX, const float TY, const float COS, const float SIN,
+    const int SIZE, const int LAYERS,
+    const int i, const int j
+) {
+    float P_i, P_j;
+    bilinear_position(TX, TY, COS, SIN, SIZE, i, j, P_i, P_j);
+    return bilinear_column_at(P_i, P_j, SIZE, LAYERS);
+}
+
+// ---------- coordinate maps ----------
+// With an integer translation, (i - SIZE/2 - TX) is an exact integer in float, so the source position of output
+// column (i, j) is the zero-translation mapping of (i - TX, j - TY), bit for bit. A CoordinateMap holds that
+// mapping for one angle, factorized into the products of the column and row coordinates with cos and sin
+// (the same operations as bilinear_column), over [-SIZE, 2*SIZE): the translations are offsets into it.
+struct CoordinateMap {
+    float ANG = 0.f;
+    int SIZE = 0;
+    std::vector<float> coord_cos, coord_sin; // (x - SIZE/2) * cos(ANG) and * sin(ANG), for x = index - SIZE
+
+    bool covers(const int TX, const int TY) const { return std::abs(TX) <= SIZE && std::abs(TY) <= SIZE; }
+};
+
+inline CoordinateMap build_coordinate_map(const float ANG, const int SIZE) {
+    const float COS = std::cos(ANG);
+    const float SIN = std::sin(ANG);
+    CoordinateMap map;
+    map.ANG = ANG;
+    map.SIZE = SIZE;
+    for (int x = -SIZE; x < 2 * SIZE; x++) {
+        map.coord_cos.push_back((x-SIZE/2.f)*COS);
+        map.coord_sin.push_back((x-SIZE/2.f)*SIN);
+    }
+    return map;
+}
+
+inline bool is_integer_translation(const float TX, const float TY) {
+    return TX == std::trunc(TX) && TY == std::trunc(TY) && std::abs(TX) < (1 << 24) && std::abs(TY) < (1 << 24);
+}
+
+// bilinear_column for an integer translation (map.covers(TX, TY)), same result
+inline BilinearColumn bilinear_column(
+    const CoordinateMap &map, const int TX, const int TY,
+    const int LAYERS,
+    const int i, const int j
+) {
+    const int x = i - TX + map.SIZE;
+    const int y = j - TY + map.SIZE;
+    const float P_i = map.coord_cos[x] - map.coord_sin[y] + (map.SIZE/2.f);
+    const float P_j = map.coord_sin[x] + map.coord_cos[y] + (map.SIZE/2.f);
+    return bilinear_column_at(P_i, P_j, map.SIZE, LAYERS);
+}
+
+// offset of the source column of output column (i, j) for an integer translation without rotation (-1 when out
+// of bounds): both the bilinear and the nearest-neighbour warps copy it unchanged
+inline int shifted_column(const int TX, const int TY, const int SIZE, const int LAYERS, const int i, const int j) {
+    const int si = i - TX;
+    const int sj = j - TY;
+    if (si < 0 || si >= SIZE || sj < 0 || sj >= SIZE)
+        return -1;
+    return sj * SIZE * LAYERS + si * LAYERS;
+}
+
+#ifndef COORDINATE_MAP_CACHE_SIZE
+#define COORDINATE_MAP_CACHE_SIZE 4 // angles
+#endif
+
+// The coordinate maps of the last COORDINATE_MAP_CACHE_SIZE angles (least recently used one replaced). During the
+// tx and ty line searches the angle does not change, so their evaluations reuse one map. Not thread-safe: take
+// the maps before handing them to worker threads.
+struct CoordinateMapCache {
+    uint64_t hits = 0;   // coordinate map computations avoided
+    uint64_t misses = 0; // coordinate maps built
+
+    std::shared_ptr<const CoordinateMap> get(const float ANG, const int SIZE) {
+        clock++;
+        size_t victim = 0;
+        for (size_t e = 0; e < entries.size(); e++) {
+            if (entries[e].map->ANG == ANG && entries[e].map->SIZE == SIZE) {
+                hits++;
+                entries[e].last_use = clock;
+                return entries[e].map;
+            }
+            if (entries[e].last_use < entries[victim].last_use) victim = e;
+        }
+
+        misses++;
+        Entry entry = {std::make_shared<const CoordinateMap>(build_coordinate_map(ANG, SIZE)), clock};
+        if (entries.size() < COORDINATE_MAP_CACHE_SIZE) entries.push_back(entry);
+        else entries[victim] = entry;
+        return entry.map;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const CoordinateMap> map;
+        uint64_t last_use;
+    };
+    std::vector<Entry> entries;
+    uint64_t clock = 0;
+};
+
+// blend_column for a column whose 4 source columns are in bounds: no bounds checks in the layer loop
+inline void blend_column_inside(const uint8_t *volume_src, const BilinearColumn &column, uint8_t *dest, const int N) {
+    const float R_i = column.r_i;
+    const float R_j = column.r_j;
+    const float R_i_inv = 1.f - R_i;
+    const float R_j_inv = 1.f - R_j;
+    const uint8_t *Q11 = volume_src + column.q11;
+    const uint8_t *Q12 = volume_src + column.q12;
+    const uint8_t *Q21 = volume_src + column.q21;
+    const uint8_t *Q22 = volume_src + column.q22;
+    int k = 0;
+
+    #if defined(__AVX2__)
+    const __m256 r_i = _mm256_set1_ps(R_i), r_i_inv = _mm256_set1_ps(R_i_inv);
+    const __m256 r_j = _mm256_set1_ps(R_j), r_j_inv = _mm256_set1_ps(R_j_inv);
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.f);
+    auto load = [](const uint8_t *p) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p)));
+    };
+    for (; k + 8 <= N; k += 8) {
+        const __m256 val_left = _mm256_add_ps(_mm256_mul_ps(load(Q11 + k), r_i_inv), _mm256_mul_ps(load(Q12 + k), r_i));
+        const __m256 val_right = _mm256_add_ps(_mm256_mul_ps(load(Q21 + k), r_i_inv), _mm256_mul_ps(load(Q22 + k), r_i));
+        const __m256 value = _mm256_add_ps(_mm256_mul_ps(val_left, r_j_inv), _mm256_mul_ps(val_right, r_j));
+
+        // std::round on non-negative values: truncate, then add 1 when the (exact) remainder is >= 0.5
+        __m256 pixel = _mm256_round_ps(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        pixel = _mm256_add_ps(pixel, _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(value, pixel), half, _CMP_GE_OQ), one));
+
+        const __m256i words = _mm256_cvttps_epi32(pixel);
+        const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storel_epi64((__m128i *)(dest + k), _mm_packus_epi16(packed, packed));
+    }
+    #endif
+
+    for (; k < N; k++) {
+        const float val_left = (float)Q11[k] * R_i_inv + (float)Q12[k] * R_i;
+        const float val_right = (float)Q21[k] * R_i_inv + (float)Q22[k] * R_i;
+        dest[k] = std::round(val_left * R_j_inv + val_right * R_j);
+    }
+}
+
+// Bilinear blend of the first N layers of a column into dest; gives the same bytes as transform_bilinear
+// for each layer (round half away from zero, no fused multiply-add).
+inline void blend_column(const uint8_t *volume_src, const BilinearColumn &column, uint8_t *dest, const int N) {
+    if (column.q11 < 0 && column.q12 < 0 && column.q21 < 0 && column.q22 < 0) {
+        std::memset(dest, 0, N);
+        return;
+    }
+    if (column.q11 >= 0 && column.q12 >= 0 && column.q21 >= 0 && column.q22 >= 0) {
+        blend_column_inside(volume_src, column, dest, N);
+        return;
+    }
+
+    // border column: the missing neighbours read as 0
+    const float R_i = column.r_i;
+    const float R_j = column.r_j;
+    const float R_i_inv = 1.f - R_i;
+    const float R_j_inv = 1.f - R_j;
+    auto read = [&](const int offset, const int layer) { return offset >= 0 ? (float)volume_src[offset + layer] : 0.f; };
+    for (int k = 0; k < N; k++) {
+        const float val_left = read(column.q11, k) * R_i_inv + read(column.q12, k) * R_i;
+        const float val_right = read(column.q21, k) * R_i_inv + read(column.q22, k) * R_i;
+        dest[k] = std::round(val_left * R_j_inv + val_right * R_j);
+    }
+}
+
+// source pixel of output column (i, j) for the nearest-neighbour warp; same mapping as transform_coords
+inline void nearest_position(
+    const int TX, const int TY, const float COS, const float SIN,
+    const int SIZE,
+    const int i, const int j,
+    int &new_i, int &new_j
+) {
+    const RigidWarp warp{SIZE, 1, COS, SIN, (float)TX, (float)TY, false};
+    warp.nearest_source(i, j, new_i, new_j);
+}
+
+// offset of the source column read by the nearest-neighbour warp of output column (i, j), -1 when out of
+// bounds; the offset is computed in integer arithmetic
+inline int nearest_column(
+    const int TX, const int TY, const float COS, const float SIN,
+    const int SIZE, const int LAYERS,
+    const int i, const int j
+) {
+    int new_i, new_j;
+    nearest_position(TX, TY, COS, SIN, SIZE, i, j, new_i, new_j);
+    if (new_i < 0 || new_i >= SIZE || new_j < 0 || new_j >= SIZE)
+        return -1;
+    return new_j * SIZE * LAYERS + new_i * LAYERS;
+}
+
+// ---------- row spans ----------
+// Along an output row the source coordinates are monotonic in the column i (every float operation of the
+// mapping is), so the columns that satisfy one bound on one coordinate are a prefix or a suffix of the row and
+// the columns that satisfy all of them are a single interval. Each bound is solved analytically for i and the
+// estimate is then settled on the float mapping itself, so the spans agree exactly with the per-column checks
+// and the warp only tests bounds a few times per row.
+
+struct RowSpan {
+    int begin, end; // output columns [begin, end), begin == end when empty
+};
+
+// columns i in [0, SIZE) where inside(i) holds, for a predicate that changes value at most once along the row;
+// GUESS is an estimate of the column where it changes
+template <class Predicate>
+inline RowSpan monotone_span(Predicate inside, const int SIZE, const double GUESS) {
+    const bool first = inside(0);
+    if (first == inside(SIZE - 1))
+        return first ? RowSpan{0, SIZE} : RowSpan{0, 0};
+
+    // inside(low) == first and inside(high) != first; gallop from the estimate, then bisect
+    int low = 0, high = SIZE - 1;
+    const int start = GUESS >= 1.0 ? (GUESS <= SIZE - 1.0 ? (int)GUESS : SIZE - 1) : 1;
+    if (inside(start) == first) {
+        low = start;
+        for (int step = 1; low + step < high; step *= 2) {
+            if (inside(low + step) != first) { high = low + step; break; }
+            low += step;
+        }
+    } else {
+        high = start;
+        for (int step = 1; high - step > low; step *= 2) {
+            if (inside(high - step) == first) { low = high - step; break; }
+            high -= step;
+        }
+    }
+    while (high - low > 1) {
+        const int middle = low + (high - low) / 2;
+        if (inside(middle) == first) low = middle;
+        else high = middle;
+    }
+    return first ? RowSpan{0, high} : RowSpan{high, SIZE};
+}
+
+inline RowSpan intersect_spans(const RowSpan &a, const RowSpan &b) {
+    RowSpan span = {std::max(a.begin, b.begin), std::min(a.end, b.end)};
+    if (span.end < span.begin) span.end = span.begin;
+    return span;
+}
+
+// columns of output row j whose source coordinate (coordinate(i), of slope SLOPE along the row) is within
+// [LOW, HIGH], or (LOW, HIGH) when OPEN
+template <class Coordinate>
+inline RowSpan coordinate_span(Coordinate coordinate, const float SLOPE, const float LOW, const float HIGH, const bool OPEN, const int SIZE) {
+    const double origin = coordinate(0);
+    const RowSpan above = monotone_span([&](const int i) { const float c = coordinate(i); return OPEN ? c > LOW : c >= LOW; },
+                                        SIZE, (LOW - origin) / SLOPE);
+    const RowSpan below = monotone_span([&](const int i) { const float c = coordinate(i); return OPEN ? c < HIGH : c <= HIGH; },
+                                        SIZE, (HIGH - origin) / SLOPE);
+    return intersect_spans(above, below);
+}
+
+// columns of output row j whose 4 bilinear neighbours are in bounds (interior) and whose bilinear value reads
+// at least one neighbour (support); the interior is inside the support
+inline void bilinear_row_spans(
+    const float TX, const float TY, const float COS, const float SIN,
+    const int SIZE, const int j,
+    RowSpan &support, RowSpan &interior
+) {
+    auto P_i = [&](const int i) { float p_i, p_j; bilinear_position(TX, TY, COS, SIN, SIZE, i, j, p_i, p_j); return p_i; };
+    auto P_j = [&](const int i) { float p_i, p_j; bilinear_position(TX, TY, COS, SIN, SIZE, i, j, p_i, p_j); return p_j; };
+    // floor(P) and ceil(P) both in [0, SIZE) <=> 0 <= P <= SIZE - 1; at least one of them <=> -1 < P < SIZE
+    interior = intersect_spans(coordinate_span(P_i, COS, 0.f, SIZE - 1, false, SIZE),
+                               coordinate_span(P_j, SIN, 0.f, SIZE - 1, false, SIZE));
+    support = intersect_spans(coordinate_span(P_i, COS, -1.f, SIZE, true, SIZE),
+                              coordinate_span(P_j, SIN, -1.f, SIZE, true, SIZE));
+}
+
+// columns of output row j whose nearest-neighbour source pixel is in bounds
+inline RowSpan nearest_row_span(
+    const int TX, const int TY, const float COS, const float SIN,
+    const int SIZE, const int j
+) {
+    auto new_i = [&](const int i) { int n_i, n_j; nearest_position(TX, TY, COS, SIN, SIZE, i, j, n_i, n_j); return (float)n_i; };
+    auto new_j = [&](const int i) { int n_i, n_j; nearest_position(TX, TY, COS, SIN, SIZE, i, j, n_i, n_j); return (float)n_j; };
+    return intersect_spans(coordinate_span(new_i, COS, 0.f, SIZE - 1, false, SIZE),
+                           coordinate_span(new_j, SIN, 0.f, SIZE - 1, false, SIZE));
+}
+
+// ---------- fixed-point bilinear ----------
+// Integer-only bilinear warp, in the arithmetic an FPGA interpolator stage can reproduce exactly: the source
+// position is kept in Q16 and stepped incrementally along rows and columns, its fractional part is quantized to
+// BILINEAR_FRACTION_BITS bits and the 4 weights come from a table indexed by the two quantized fractions.
+// With 4 fraction bits the weights are in units of 1/256 and the top-right, bottom-left and bottom-right ones fit
+// in 8 bits (at most 240); the top-left one is 256 minus the others. Compared to transform_bilinear a voxel can
+// differ by the quantization of the fraction (up to 1/32 of a pixel times the local gradient) plus rounding.
+constexpr int BILINEAR_FRACTION_BITS = 4;
+constexpr int BILINEAR_FRACTIONS = 1 << BILINEAR_FRACTION_BITS;
+
+struct BilinearWeights {
+    uint8_t top_right, bottom_left, bottom_right; // top-left = 256 - the others
+};
+
+struct BilinearWeightTable {
+    BilinearWeights weights[BILINEAR_FRACTIONS][BILINEAR_FRACTIONS]; // [fraction_j][fraction_i]
+
+    BilinearWeightTable() {
+        for (int fj = 0; fj < BILINEAR_FRACTIONS; fj++) {
+            for (int fi = 0; fi < BILINEAR_FRACTIONS; fi++) {
+                weights[fj][fi].top_right = fi * (BILINEAR_FRACTIONS - fj);
+                weights[fj][fi].bottom_left = (BILINEAR_FRACTIONS - fi) * fj;
+                weights[fj][fi].bottom_right = fi * fj;
+            }
+        }
+    }
+};
+
+inline const BilinearWeightTable &bilinear_weight_table() {
+    static const BilinearWeightTable table; // read-only after construction
+    return table;
+}
+
+// offsets of the 4 source columns (-1 when out of bounds) and the weights of a fixed-point bilinear column
+struct FixedBilinearColumn {
+    int q11, q12, q21, q22; // top-left, top-right, bottom-left, bottom-right
+    BilinearWeights weights;
+};
+
+// P_I and P_J are the source position in Q16; the fraction is rounded to the nearest 1/BILINEAR_FRACTIONS
+inline FixedBilinearColumn fixed_bilinear_column(const int P_I, const int P_J, const int SIZE, const int LAYERS) {
+    constexpr int HALF_STEP = 1 << (15 - BILINEAR_FRACTION_BITS);
+    const int left = (P_I + HALF_STEP) >> 16; // floor, also for negative positions
+    const int top = (P_J + HALF_STEP) >> 16;
+    const int fraction_i = ((P_I + HALF_STEP) >> (16 - BILINEAR_FRACTION_BITS)) & (BILINEAR_FRACTIONS - 1);
+    const int fraction_j = ((P_J + HALF_STEP) >> (16 - BILINEAR_FRACTION_BITS)) & (BILINEAR_FRACTIONS - 1);
+
+    auto offset = [&](const int i, const int j) {
+        return (i >= 0 && i < SIZE && j >= 0 && j < SIZE) ? j * SIZE * LAYERS + i * LAYERS : -1;
+    };
+    FixedBilinearColumn column;
+    column.q11 = offset(left, top);
+    column.q12 = offset(left + 1, top);
+    column.q21 = offset(left, top + 1);
+    column.q22 = offset(left + 1, top + 1);
+    column.weights = bilinear_weight_table().weights[fraction_j][fraction_i];
+    return column;
+}
+
+// dest[k] = (w11*Q11 + w12*Q12 + w21*Q21 + w22*Q22 + 128) >> 8 for the first N layers of a column
+inline void blend_column_fixed(const uint8_t *volume_src, const FixedBilinearColumn &column, uint8_t *dest, const int N) {
+    if (column.q11 < 0 && column.q12 < 0 && column.q21 < 0 && column.q22 < 0) {
+        std::memset(dest, 0, N);
+        return;
+    }
+
+    const unsigned int W12 = column.weights.top_right;
+    const unsigned int W21 = column.weights.bottom_left;
+    const unsigned int W22 = column.weights.bottom_right;
+    const unsigned int W11 = 256 - W12 - W21 - W22;
+    int k = 0;
+
+    #if defined(__AVX2__)
+    if (column.q11 >= 0 && column.q12 >= 0 && column.q21 >= 0 && column.q22 >= 0) {
+        const uint8_t *Q11 = volume_src + column.q11;
+        const uint8_t *Q12 = volume_src + column.q12;
+        const uint8_t *Q21 = volume_src + column.q21;
+        const uint8_t *Q22 = volume_src + column.q22;
+
+        // 16-bit lanes: the weighted sum is at most 256 * 255 + 128
+        const __m256i w11 = _mm256_set1_epi16(W11), w12 = _mm256_set1_epi16(W12);
+        const __m256i w21 = _mm256_set1_epi16(W21), w22 = _mm256_set1_epi16(W22);
+        const __m256i half = _mm256_set1_epi16(128);
+        auto load = [](const uint8_t *p) { return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p)); };
+        for (; k + 16 <= N; k += 16) {
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(load(Q11 + k), w11), _mm256_mullo_epi16(load(Q12 + k), w12));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(load(Q21 + k), w21));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(load(Q22 + k), w22));
+            const __m256i pixel = _mm256_srli_epi16(_mm256_add_epi16(sum, half), 8);
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pixel, pixel), 0x08);
+            _mm_storeu_si128((__m128i *)(dest + k), _mm256_castsi256_si128(packed));
+        }
+    }
+    #endif
+
+    auto read = [&](const int offset, const int layer) { return offset >= 0 ? (unsigned int)volume_src[offset + layer] : 0u; };
+    for (; k < N; k++)
+        dest[k] = (W11 * read(column.q11, k) + W12 * read(column.q12, k) + W21 * read(column.q21, k) + W22 * read(column.q22, k) + 128) >> 8;
+}
+
+#ifndef WARP_PREFETCH_DISTANCE
+#define WARP_PREFETCH_DISTANCE 4 // columns ahead
+#endif
+
+// prefetches the source lines a bilinear column will read (left and right columns are adjacent)
+template <class Column>
+inline void prefetch_column(const uint8_t *volume_src, const Column &column, const int LAYERS) {
+    for (const int offset : {column.q11 >= 0 ? column.q11 : column.q12, column.q21 >= 0 ? column.q21 : column.q22}) {
+        if (offset < 0) continue;
+        for (int b = 0; b < 2 * LAYERS; b += 64)
+            __builtin_prefetch(volume_src + offset + b);
+    }
+}
+
+// Warps output rows [row_begin, row_end) one depth column at a time: the source position is mapped once per
+// column, nearest neighbour copies the source column with memcpy and bilinear blends the 4 source columns.
+// Same output as transform_volume_voxelwise, except that the voxelwise nearest-neighbour offsets are rounded
+// in float arithmetic and can pick a neighbouring layer on large volumes.
+// An integer translation without rotation copies whole rows with memmove. Otherwise the columns of each row that
+// read no source pixel are zero-filled with memset around the row spans (see bilinear_row_spans), and the
+// columns whose neighbours are all in bounds are mapped and blended without bounds checks.
+// Every source column read is reported to tracker (see access_profile.hpp).
+template <class Tracker = NoAccessTracking>
+void transform_rows(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX, const float TY, const float ANG,
+    const int SIZE, const int LAYERS,
+    const bool bilinear_interpolation,
+    const int row_begin, const int row_end,
+    Tracker &&tracker = Tracker()
+) {
+    const float COS = std::cos(ANG);
+    const float SIN = std::sin(ANG);
+    std::vector<BilinearColumn> columns(bilinear_interpolation ? SIZE : 0);
+
+    // integer translation without rotation: every output row is a shifted source row, in both modes
+    const bool shift = ANG == 0.f && is_integer_translation(TX, TY);
+    const int SHIFT_TX = shift ? (int)TX : 0;
+    const int SHIFT_TY = shift ? (int)TY : 0;
+
+    for (int j = row_begin; j < row_end; j++) {
+        uint8_t *dest_row = volume_dest + (size_t)j * SIZE * LAYERS;
+        tracker.begin_row();
+
+        if (shift) {
+            const int source_row = j - SHIFT_TY;
+            const int begin = std::max(0, SHIFT_TX); // output columns [begin, end) have a source column
+            const int end = std::min(SIZE, SIZE + SHIFT_TX);
+            if (source_row < 0 || source_row >= SIZE || begin >= end) {
+                std::memset(dest_row, 0, (size_t)SIZE * LAYERS);
+            } else {
+                for (int i = begin; i < end; i++)
+                    tracker.read_column(shifted_column(SHIFT_TX, SHIFT_TY, SIZE, LAYERS, i, j));
+                std::memset(dest_row, 0, (size_t)begin * LAYERS);
+                std::memmove(dest_row + (size_t)begin * LAYERS, volume_src + (size_t)shifted_column(SHIFT_TX, SHIFT_TY, SIZE, LAYERS, begin, j), (size_t)(end - begin) * LAYERS);
+                std::memset(dest_row + (size_t)end * LAYERS, 0, (size_t)(SIZE - end) * LAYERS);
+            }
+            tracker.end_row();
+            continue;
+        }
+
+        if (!bilinear_interpolation) {
+            const RowSpan span = nearest_row_span(TX, TY, COS, SIN, SIZE, j);
+            std::memset(dest_row, 0, (size_t)span.begin * LAYERS);
+            for (int i = span.begin; i < span.end; i++) {
+                int new_i, new_j;
+                nearest_position(TX, TY, COS, SIN, SIZE, i, j, new_i, new_j);
+                const int offset = new_j * SIZE * LAYERS + new_i * LAYERS;
+                tracker.read_column(offset);
+                std::memcpy(dest_row + (size_t)i * LAYERS, volume_src + offset, LAYERS);
+            }
+            std::memset(dest_row + (size_t)span.end * LAYERS, 0, (size_t)(SIZE - span.end) * LAYERS);
+            tracker.end_row();
+            continue;
+        }
+
+        RowSpan support, interior;
+        bilinear_row_spans(TX, TY, COS, SIN, SIZE, j, support, interior);
+        if (interior.begin == interior.end) interior = {support.end, support.end};
+
+        // map the whole span first, so the gather of the next columns can be prefetched
+        for (int i = support.begin; i < support.end; i++) {
+            float P_i, P_j;
+            bilinear_position(TX, TY, COS, SIN, SIZE, i, j, P_i, P_j);
+            const bool inside = i >= interior.begin && i < interior.end;
+            columns[i] = inside ? bilinear_column_inside(P_i, P_j, SIZE, LAYERS) : bilinear_column_at(P_i, P_j, SIZE, LAYERS);
+        }
+        std::memset(dest_row, 0, (size_t)support.begin * LAYERS);
+        for (int i = support.begin; i < support.end; i++) {
+            if (i + WARP_PREFETCH_DISTANCE < support.end)
+                prefetch_column(volume_src, columns[i + WARP_PREFETCH_DISTANCE], LAYERS);
+            for (const int offset : {columns[i].q11, columns[i].q12, columns[i].q21, columns[i].q22})
+                if (offset >= 0) tracker.read_column(offset);
+            if (i >= interior.begin && i < interior.end)
+                blend_column_inside(volume_src, columns[i], dest_row + (size_t)i * LAYERS, LAYERS);
+            else
+                blend_column(volume_src, columns[i], dest_row + (size_t)i * LAYERS, LAYERS);
+        }
+        std::memset(dest_row + (size_t)support.end * LAYERS, 0, (size_t)(SIZE - support.end) * LAYERS);
+        tracker.end_row();
+    }
+}
+
 void transform_volume(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX,
+    const float TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    const bool bilinear_interpolation,
+    int N_THREADS
+) {
+    #ifndef USE_OLD_FORMAT
+    if (!bilinear_interpolation && nearest_warp_engine() == THREE_SHEAR) {
+        // B and C are released after the warp; callers that warp repeatedly can keep a ShearBuffers of their
+        // own and call transform_volume_three_shear directly
+        transform_volume_three_shear(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, N_THREADS);
+        return;
+    }
+    // Every output row is warped by exactly one thread (contiguous row slabs, see parallel_for_slabs), so the
+    // output does not depend on N_THREADS. When volume_dest is freshly allocated and not yet written (new[],
+    // not a zero-filled std::vector) each slab is also first touched by the thread that warps it, which keeps
+    // its pages on that thread's NUMA node.
+    parallel_for_slabs(SIZE, N_THREADS, [&](int, int row_begin, int row_end) {
+        transform_rows(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, bilinear_interpolation, row_begin, row_end);
+    });
+    #else
+    // the depth columns are not contiguous in the old format
+    transform_volume_voxelwise(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, bilinear_interpolation);
+    #endif
+}
+
+// transform_volume that also records the source-access profile of every thread (profiles[t] for row slab t)
+void transform_volume_profiled(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX,
+    const float TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    const bool bilinear_interpolation,
+    std::vector<AccessProfile> &profiles,
+    int N_THREADS = sw_num_threads()
+) {
+    #ifndef USE_OLD_FORMAT
+    N_THREADS = std::max(1, std::min(N_THREADS, SIZE)); // as in parallel_for_slabs
+    profiles.assign(N_THREADS, AccessProfile());
+    parallel_for_slabs(SIZE, N_THREADS, [&](int t, int row_begin, int row_end) {
+        profiles[t].reset(SIZE, LAYERS, (bilinear_interpolation ? 4 : 1) * SIZE * (row_end - row_begin));
+        transform_rows(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, bilinear_interpolation, row_begin, row_end, profiles[t]);
+    });
+    #else
+    profiles.clear(); // the voxelwise warp is not profiled
+    transform_volume_voxelwise(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, bilinear_interpolation);
+    #endif
+}
+
+// Fixed-point bilinear warp of output rows [row_begin, row_end): the Q16 source position of output voxel (i, j)
+// is the Q16 position of (0, 0) plus i and j times the Q16 steps, so the rows need no floating point.
+void transform_rows_fixed_point(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX, const float TY, const float ANG,
+    const int SIZE, const int LAYERS,
+    const int row_begin, const int row_end
+) {
+    const double COS = std::cos(ANG);
+    const double SIN = std::sin(ANG);
+    auto q16 = [](const double x) { return (int)std::llround(x * 65536.0); };
+    const int P_I_ORIGIN = q16((-SIZE/2.0 - TX)*COS - (-SIZE/2.0 - TY)*SIN + SIZE/2.0);
+    const int P_J_ORIGIN = q16((-SIZE/2.0 - TX)*SIN + (-SIZE/2.0 - TY)*COS + SIZE/2.0);
+    const int COS_Q16 = q16(COS);
+    const int SIN_Q16 = q16(SIN);
+
+    std::vector<FixedBilinearColumn> columns(SIZE);
+    for (int j = row_begin; j < row_end; j++) {
+        int p_i = P_I_ORIGIN - j * SIN_Q16;
+        int p_j = P_J_ORIGIN + j * COS_Q16;
+        for (int i = 0; i < SIZE; i++, p_i += COS_Q16, p_j += SIN_Q16)
+            columns[i] = fixed_bilinear_column(p_i, p_j, SIZE, LAYERS);
+
+        uint8_t *dest_row = volume_dest + (size_t)j * SIZE * LAYERS;
+        for (int i = 0; i < SIZE; i++) {
+            if (i + WARP_PREFETCH_DISTANCE < SIZE)
+                prefetch_column(volume_src, columns[i + WARP_PREFETCH_DISTANCE], LAYERS);
+            blend_column_fixed(volume_src, columns[i], dest_row + (size_t)i * LAYERS, LAYERS);
+        }
+    }
+}
+
+// transform_volume(MODE_BILINEAR) in fixed point (see blend_column_fixed), split by output rows like transform_volume
+void transform_volume_fixed_point(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const float TX,
+    const float TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    int N_THREADS
+) {
+    #ifndef USE_OLD_FORMAT
+    parallel_for_slabs(SIZE, N_THREADS, [&](int, int row_begin, int row_end) {
+        transform_rows_fixed_point(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, row_begin, row_end);
+    });
+    #else
+    // the depth columns are not contiguous in the old format
+    transform_volume_voxelwise(volume_src, volume_dest, TX, TY, ANG, SIZE, LAYERS, MODE_BILINEAR);
+    #endif
+}
+
+// one voxel at a time through transform_bilinear/transform_nearest_neighbour (reference implementation)
+void transform_volume_voxelwise(
     uint8_t *volume_src,
     uint8_t *volume_dest,
     const float TX,
@@ -234,13 +909,15 @@ void transform_volume(
     float cc_tra = 0;
     float rr_tra = 0;
 
+    LineBuffer cache; // local to this call, so concurrent warps do not share state
+
     for (int i = 0; i < SIZE; i++) {
         for (int j = 0; j < SIZE; j++) {
             for (int k = 0; k < LAYERS; k++) {
 
                 uint16_t pixel;
                 if (bilinear_interpolation)
-                    pixel = transform_bilinear(volume_src, TX, TY, ANG, SIZE, LAYERS, i, j, k);
+                    pixel = transform_bilinear(volume_src, TX, TY, ANG, SIZE, LAYERS, i, j, k, &cache);
                 else
                     pixel = transform_nearest_neighbour(volume_src, TX, TY, ANG, SIZE, LAYERS, i, j, k);
 
@@ -474,31 +1151,3 @@ int vector_to_mats(uint8_t* volume, std::vector<cv::Mat> images, int SIZE, int N
         images[i] = slice;
     }
 }
-
-
-uint8_t track_reads(uint8_t *mem, const int index, float *ratio) {
-    static unsigned int sequential_count = 0;
-    static unsigned int total_count = 0;
-    static unsigned int last_index = -2;
-
-    if (ratio == NULL) {
-        ++total_count;
-        if (index == last_index + 1) {
-            ++sequential_count;
-        }
-        last_index = index;
-
-        #ifdef DEBUG_ACCESSED_INDEXES
-        std::cout << index << " ";
-        #endif
-
-        return mem[index];
-    }
-
-    if (total_count != 0)
-        *ratio = 100.0f * sequential_count / (float)total_count;
-    else
-        *ratio = 0.0f;
-    
-    return -1;
-}
@@ -0,0 +1,213 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../thread_utils/thread_utils.hpp"
+
+// Engines of the nearest-neighbour warp: DIRECT_MAPPING maps every output column to its source column
+// (transform_rows), THREE_SHEAR splits the rotation into three 1D shears (transform_volume_three_shear).
+enum NearestWarpEngine { DIRECT_MAPPING = 0, THREE_SHEAR = 1 };
+
+// compile-time default of the nearest-neighbour engine
+#ifndef SW_NEAREST_ENGINE
+#define SW_NEAREST_ENGINE DIRECT_MAPPING
+#endif
+
+// the SW_NEAREST_ENGINE environment variable ("direct" or "shear") takes precedence over the compile-time default;
+// atomic because transform_volume reads it from any thread that warps
+inline std::atomic<NearestWarpEngine> &nearest_warp_engine_setting() {
+    static std::atomic<NearestWarpEngine> engine([]() {
+        const char *env = std::getenv("SW_NEAREST_ENGINE");
+        if (env && std::string(env) == "shear") return THREE_SHEAR;
+        if (env && std::string(env) == "direct") return DIRECT_MAPPING;
+        return (NearestWarpEngine)SW_NEAREST_ENGINE;
+    }());
+    return engine;
+}
+
+// overrides the nearest-neighbour engine at runtime
+inline void set_nearest_warp_engine(const NearestWarpEngine engine) {
+    nearest_warp_engine_setting() = engine;
+}
+
+inline NearestWarpEngine nearest_warp_engine() {
+    return nearest_warp_engine_setting();
+}
+
+// ---------- three-shear rotation ----------
+// Paeth decomposition: the source position of output pixel d is R(ANG) (d - c) + c - T, and R(ANG) is a quarter
+// turn R(q pi/2) times R(t) with |t| <= pi/4, where R(t) = Sx(a) Sy(b) Sx(a), a = -tan(t/2), b = sin(t),
+// Sx(a) (x, y) = (x + a y, y) and Sy(b) (x, y) = (x, y + b x). The warp runs the chain backwards from the source:
+//   pass 1: B(v) = src(R_q Sx(a) v + c - T)  rows of B are shifted (or, for odd q, transposed) source lines
+//   pass 2: C(u) = B(Sy(b) u)                columns of C are shifted columns of B
+//   pass 3: dest(d) = C(Sx(a) d)             rows of dest are shifted rows of C
+// Every shift is rounded to whole pixels once per row or column, so each pass moves contiguous depth columns
+// (whole rows with memcpy in passes 1 and 3) instead of gathering them one by one. The result differs from the
+// direct mapping where the three roundings do not add up to the rounding of the exact position: the source
+// pixel of those columns is a neighbour of the direct one. B and C are sized to the sheared extents (up to about
+// 2.8 and 1.4 times the volume at 45 degrees). The translation may be fractional: pass 1 rounds it together with
+// the source position of each line (the direct mapping truncates it to whole pixels, as transform_coords does).
+
+// shift of a shear pass for a line at coordinate x (relative to the centre c): round(factor * (x - c))
+inline int shear_shift(const double factor, const int x, const double c) {
+    return (int)std::floor(factor * (x - c) + 0.5);
+}
+
+// an image of WIDTH x HEIGHT depth columns whose column x and row y are at coordinates (x0 + x, y0 + y)
+struct ShearImage {
+    int x0, y0, WIDTH, HEIGHT, LAYERS;
+    uint8_t *data;
+
+    uint8_t *row(const int y) const { return data + (size_t)(y - y0) * WIDTH * LAYERS; }
+    uint8_t *column(const int x, const int y) const { return row(y) + (size_t)(x - x0) * LAYERS; }
+};
+
+// intermediate images B and C of the three-shear warp, kept by the caller across warps (one per concurrent warp)
+struct ShearBuffers {
+    std::unique_ptr<uint8_t[]> sheared_rows, sheared_columns; // B and C, never initialized: every byte is written
+    size_t rows_capacity = 0, columns_capacity = 0;
+
+    uint8_t *rows(const size_t bytes) { return reserve(sheared_rows, rows_capacity, bytes); }
+    uint8_t *columns(const size_t bytes) { return reserve(sheared_columns, columns_capacity, bytes); }
+
+private:
+    static uint8_t *reserve(std::unique_ptr<uint8_t[]> &buffer, size_t &capacity, const size_t bytes) {
+        if (bytes > capacity) {
+            buffer.reset(new uint8_t[bytes]);
+            capacity = bytes;
+        }
+        return buffer.get();
+    }
+};
+
+// buffers = nullptr allocates B and C for this call only
+inline void transform_volume_three_shear(
+    uint8_t *volume_src,
+    uint8_t *volume_dest,
+    const double TX,
+    const double TY,
+    const float ANG,
+    const int SIZE,
+    const int LAYERS,
+    int N_THREADS = sw_num_threads(),
+    ShearBuffers *buffers = nullptr
+) {
+    const double QUARTER = M_PI / 2.0;
+    const int q = (int)std::lround(ANG / QUARTER);
+    const double t = ANG - q * QUARTER;
+    const double a = -std::tan(t / 2.0);
+    const double b = std::sin(t);
+    const double c = SIZE / 2.0;
+
+    // R_q (1, 0) and R_q (0, 1): the source step along a row of B and across its rows
+    static const int ROTATE[4][4] = {{1, 0, 0, 1}, {0, 1, -1, 0}, {-1, 0, 0, -1}, {0, -1, 1, 0}};
+    const int *R = ROTATE[((q % 4) + 4) % 4];
+
+    // extents: dest rows read C columns [x_low, x_high]; those C columns read B rows [y_low, y_high]
+    const int x_low = std::min(shear_shift(a, 0, c), shear_shift(a, SIZE - 1, c));
+    const int x_high = SIZE - 1 + std::max(shear_shift(a, 0, c), shear_shift(a, SIZE - 1, c));
+    const int y_low = std::min(shear_shift(b, x_low, c), shear_shift(b, x_high, c));
+    const int y_high = SIZE - 1 + std::max(shear_shift(b, x_low, c), shear_shift(b, x_high, c));
+    const int WIDTH = x_high - x_low + 1;
+
+    // no residual rotation: B is dest itself
+    const bool single_pass = a == 0.0 && b == 0.0;
+    ShearBuffers local_buffers;
+    if (buffers == nullptr) buffers = &local_buffers;
+    const int HEIGHT = y_high - y_low + 1;
+    const ShearImage B = single_pass ? ShearImage{0, 0, SIZE, SIZE, LAYERS, volume_dest}
+                                     : ShearImage{x_low, y_low, WIDTH, HEIGHT, LAYERS, buffers->rows((size_t)WIDTH * HEIGHT * LAYERS)};
+    const ShearImage C = single_pass ? ShearImage{}
+                                     : ShearImage{x_low, 0, WIDTH, SIZE, LAYERS, buffers->columns((size_t)WIDTH * SIZE * LAYERS)};
+
+    // pass 1: row y of B reads the source line starting at (sx, sy) (rounded once) with step (R[0], R[1])
+    parallel_for_slabs(B.HEIGHT, N_THREADS, [&](int, int begin, int end) {
+        for (int y = B.y0 + begin; y < B.y0 + end; y++) {
+            const double row_x = a * (y - c) - c; // Sx(a) v - c at v = (0, y)
+            const double row_y = y - c;
+            const int sx = (int)std::floor(R[0] * row_x + R[2] * row_y + c - TX + 0.5);
+            const int sy = (int)std::floor(R[1] * row_x + R[3] * row_y + c - TY + 0.5);
+
+            // columns [first, last) of B with 0 <= start + step * x < SIZE on both source coordinates
+            int first = B.x0, last = B.x0 + B.WIDTH;
+            auto clip = [&](const int start, const int step) {
+                if (step == 0) {
+                    if (start < 0 || start >= SIZE) last = B.x0;
+                } else if (step > 0) {
+                    first = std::max(first, -start);
+                    last = std::min(last, SIZE - start);
+                } else {
+                    first = std::max(first, start - SIZE + 1);
+                    last = std::min(last, start + 1);
+                }
+            };
+            clip(sx, R[0]);
+            clip(sy, R[1]);
+            first = std::min(first, B.x0 + B.WIDTH);
+            last = std::max(first, last);
+
+            uint8_t *row = B.row(y);
+            std::memset(row, 0, (size_t)(first - B.x0) * LAYERS);
+            if (R[0] == 1) {
+                if (last > first)
+                    std::memcpy(B.column(first, y), volume_src + ((size_t)sy * SIZE + sx + first) * LAYERS, (size_t)(last - first) * LAYERS);
+            } else {
+                for (int x = first; x < last; x++)
+                    std::memcpy(B.column(x, y), volume_src + ((size_t)(sy + R[1] * x) * SIZE + sx + R[0] * x) * LAYERS, LAYERS);
+            }
+            std::memset(B.column(last, y), 0, (size_t)(B.x0 + B.WIDTH - last) * LAYERS);
+        }
+    });
+    if (single_pass) return;
+
+    // pass 2: column x of C is column x of B shifted by shear_shift(b, x, c) rows; the columns with the same
+    // shift form runs of about 1 / |b| columns, copied with one memcpy per row
+    struct ShiftRun { int begin, end, shift; };
+    std::vector<ShiftRun> runs;
+    for (int x = x_low; x <= x_high; x++) {
+        const int shift = shear_shift(b, x, c);
+        if (runs.empty() || runs.back().shift != shift) runs.push_back({x, x + 1, shift});
+        else runs.back().end = x + 1;
+    }
+    parallel_for_slabs(SIZE, N_THREADS, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++)
+            for (const ShiftRun &run : runs)
+                std::memcpy(C.column(run.begin, y), B.column(run.begin, y + run.shift), (size_t)(run.end - run.begin) * LAYERS);
+    });
+
+    // pass 3: row y of dest is row y of C shifted by shear_shift(a, y, c) columns
+    parallel_for_slabs(SIZE, N_THREADS, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++)
+            std::memcpy(volume_dest + (size_t)y * SIZE * LAYERS, C.column(shear_shift(a, y, c), y), (size_t)SIZE * LAYERS);
+    });
+}
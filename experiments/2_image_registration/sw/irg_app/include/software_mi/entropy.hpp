@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "constants.h"
+
+// counts below this value take c*log2(c) from a precomputed table, larger ones (a handful of bins
+// per histogram) call log2 directly
+#ifndef NLOGN_TABLE_SIZE
+#define NLOGN_TABLE_SIZE 4096
+#endif
+
+inline const double *nlogn_table() {
+    static const std::vector<double> table = [] {
+        std::vector<double> t(NLOGN_TABLE_SIZE);
+        t[0] = 0.0;
+        for (int c = 1; c < NLOGN_TABLE_SIZE; c++)
+            t[c] = c * std::log2((double)c);
+        return t;
+    }();
+    return table.data();
+}
+
+// c*log2(c), with 0*log2(0) = 0
+inline double nlogn(const uint64_t c, const double *table = nlogn_table()) {
+    return c < NLOGN_TABLE_SIZE ? table[c] : (double)c * std::log2((double)c);
+}
+
+// sum over the bins of c*log2(c)
+inline double sum_nlogn(const uint32_t *counts, const int N_BINS) {
+    const double *table = nlogn_table();
+    double sum = 0.0;
+    for (int b = 0; b < N_BINS; b++)
+        sum += nlogn(counts[b], table);
+    return sum;
+}
+
+// Shannon entropy (bits) of a histogram of N_SAMPLES integer counts:
+// H = -sum p*log2(p) = log2(N) - sum c*log2(c) / N
+inline double entropy_from_counts(const uint32_t *counts, const int N_BINS, const uint64_t N_SAMPLES) {
+    return std::log2((double)N_SAMPLES) - sum_nlogn(counts, N_BINS) / N_SAMPLES;
+}
+
+// Mutual information of a BINS x BINS joint histogram of integer counts ([ref][flt]).
+// MI = H(ref) + H(flt) - H(ref,flt) = log2(N) + (S(ref,flt) - S(ref) - S(flt)) / N, with S = sum c*log2(c);
+// the counts are never normalized and everything is accumulated in double.
+template <int BINS = J_HISTO_ROWS>
+inline double mutual_information_from_counts(const uint32_t *j_h, const uint64_t N_SAMPLES) {
+    if (N_SAMPLES == 0)
+        return 0.0;
+
+    uint32_t href[BINS] = {0};
+    uint32_t hflt[BINS] = {0};
+    for (int i = 0; i < BINS; i++) {
+        for (int j = 0; j < BINS; j++) {
+            href[i] += j_h[i * BINS + j];
+            hflt[j] += j_h[i * BINS + j];
+        }
+    }
+
+    const double joint = sum_nlogn(j_h, BINS * BINS);
+    const double ref = sum_nlogn(href, BINS);
+    const double flt = sum_nlogn(hflt, BINS);
+    return std::log2((double)N_SAMPLES) + (joint - ref - flt) / N_SAMPLES;
+}
+
+// Same as above with the reference term S(ref) known in advance (the reference marginal of a registration
+// does not change between evaluations): only the floating marginal is accumulated.
+template <int BINS = J_HISTO_ROWS>
+inline double mutual_information_from_counts(const uint32_t *j_h, const uint64_t N_SAMPLES, const double REF_NLOGN) {
+    if (N_SAMPLES == 0)
+        return 0.0;
+
+    uint32_t hflt[BINS] = {0};
+    for (int i = 0; i < BINS; i++)
+        for (int j = 0; j < BINS; j++)
+            hflt[j] += j_h[i * BINS + j];
+
+    const double joint = sum_nlogn(j_h, BINS * BINS);
+    const double flt = sum_nlogn(hflt, BINS);
+    return std::log2((double)N_SAMPLES) + (joint - REF_NLOGN - flt) / N_SAMPLES;
+}
@@ -0,0 +1,129 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Sparse view of a reference/floating pair, built once per registration. Columns (row, col) whose DEPTH
+// voxels are all zero in the reference are dropped from the reference run list; the floating volume is
+// summarized by the bounding box of its non-zero voxels. A voxel outside the reference runs whose warped
+// floating position misses the (dilated) bounding box is a (0, 0) pair, so it can be counted without
+// being visited.
+
+// columns [begin, end) of one row
+struct ColumnRun {
+    int begin;
+    int end;
+};
+
+struct ForegroundIndex {
+    int SIZE = 0;
+    std::vector<uint32_t> row_offsets;  // runs of row r are runs[row_offsets[r] .. row_offsets[r+1])
+    std::vector<ColumnRun> runs;
+    size_t reference_columns = 0;       // columns covered by the runs
+    bool floating_empty = true;
+    int flt_col_min = 0, flt_col_max = -1;  // inclusive bounding box of the non-zero floating voxels
+    int flt_row_min = 0, flt_row_max = -1;
+
+    // fraction of the reference columns holding at least one non-zero voxel
+    double reference_fraction() const { return SIZE ? (double)reference_columns / ((size_t)SIZE * SIZE) : 0.0; }
+};
+
+inline bool column_is_zero(const uint8_t *column, const int DEPTH) {
+    for (int k = 0; k < DEPTH; k++)
+        if (column[k]) return false;
+    return true;
+}
+
+inline ForegroundIndex build_foreground_index(const uint8_t *input_ref, const uint8_t *input_flt, const int SIZE, const int LAYERS, const int DEPTH) {
+    ForegroundIndex index;
+    index.SIZE = SIZE;
+    index.row_offsets.reserve(SIZE + 1);
+    for (int row = 0; row < SIZE; row++) {
+        index.row_offsets.push_back(index.runs.size());
+        int begin = -1;
+        for (int col = 0; col <= SIZE; col++) {
+            const bool zero = col == SIZE || column_is_zero(input_ref + ((size_t)row * SIZE + col) * LAYERS, DEPTH);
+            if (!zero && begin < 0) {
+                begin = col;
+            } else if (zero && begin >= 0) {
+                index.runs.push_back({begin, col});
+                index.reference_columns += col - begin;
+                begin = -1;
+            }
+        }
+    }
+    index.row_offsets.push_back(index.runs.size());
+
+    for (int row = 0; row < SIZE; row++) {
+        for (int col = 0; col < SIZE; col++) {
+            if (column_is_zero(input_flt + ((size_t)row * SIZE + col) * LAYERS, DEPTH)) continue;
+            if (index.floating_empty) {
+                index.flt_col_min = index.flt_col_max = col;
+                index.flt_row_min = index.flt_row_max = row;
+                index.floating_empty = false;
+            }
+            index.flt_col_min = std::min(index.flt_col_min, col);
+            index.flt_col_max = std::max(index.flt_col_max, col);
+            index.flt_row_min = std::min(index.flt_row_min, row);
+            index.flt_row_max = std::max(index.flt_row_max, row);
+        }
+    }
+    return index;
+}
+
+// Columns of output row ROW whose bilinear sample (same mapping as transform_bilinear) may touch a
+// non-zero floating voxel. Returns false when there are none. The span is conservative: the bounding box
+// is dilated by the interpolation footprint plus one pixel of slack for rounding.
+inline bool floating_span(const ForegroundIndex &index, const float TX, const float TY, const float ANG, const int ROW, ColumnRun &span) {
+    if (index.floating_empty) return false;
+    const int SIZE = index.SIZE;
+    const double half = SIZE / 2.0;
+    const double c = std::cos((double)ANG), s = std::sin((double)ANG);
+    const double y = ROW - half - TY;
+
+    double lo = 0.0, hi = SIZE - 1.0;
+    // P = slope * (col - half - TX) + offset must fall in [min - 2, max + 2]
+    auto clip = [&](const double slope, const double offset, const int min, const int max) {
+        const double low = min - 2.0 - offset, high = max + 2.0 - offset;
+        if (std::fabs(slope) < 1e-9) {
+            if (low > 0.0 || high < 0.0) hi = -1.0;
+            return;
+        }
+        double a = low / slope + half + TX, b = high / slope + half + TX;
+        if (a > b) std::swap(a, b);
+        lo = std::max(lo, a);
+        hi = std::min(hi, b);
+    };
+    clip(c, -y * s + half, index.flt_col_min, index.flt_col_max);
+    clip(s, y * c + half, index.flt_row_min, index.flt_row_max);
+    if (lo > hi) return false;
+
+    span.begin = std::max(0, (int)std::floor(lo) - 1);
+    span.end = std::min(SIZE, (int)std::ceil(hi) + 2);
+    return span.begin < span.end;
+}
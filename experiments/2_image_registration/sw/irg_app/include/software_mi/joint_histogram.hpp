@@ -0,0 +1,296 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "constants.h"
+#include "../thread_utils/thread_utils.hpp"
+
+#define J_HISTO_BINS (J_HISTO_ROWS * J_HISTO_COLS)
+
+// The software MI can bin the 8-bit intensities into BINS = 256/128/64/32 levels per axis (template
+// parameter, J_HISTO_ROWS by default so that a binned hardware build and the software agree). An intensity
+// v falls in bin v >> (8 - log2(BINS)), i.e. the BINS levels are its most significant bits.
+template <int BINS>
+constexpr int bin_shift() {
+    static_assert(BINS == 256 || BINS == 128 || BINS == 64 || BINS == 32, "BINS must be 256, 128, 64 or 32");
+    return BINS == 256 ? 0 : BINS == 128 ? 1 : BINS == 64 ? 2 : 3;
+}
+
+template <int BINS>
+inline unsigned int quantize(const uint8_t v) {
+    return v >> bin_shift<BINS>();
+}
+
+// number of sub-histograms the voxel pairs are spread over: consecutive increments of the same bin
+// land in different sub-histograms, which avoids store-to-load forwarding stalls on uniform regions
+#ifndef J_HISTO_LANES
+#define J_HISTO_LANES 4
+#endif
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Quantizes N intensities to BINS levels (dst may alias src). There is no 8-bit shift in AVX2/AVX-512:
+// the bytes are shifted as 16-bit words and the bits coming from the neighbouring byte are masked out.
+template <int BINS>
+inline void quantize_run(const uint8_t *src, uint8_t *dst, const size_t N) {
+    constexpr int SHIFT = bin_shift<BINS>();
+    size_t n = 0;
+    if constexpr (SHIFT == 0) {
+        if (dst != src) std::memcpy(dst, src, N);
+        return;
+    }
+#if defined(__AVX512BW__)
+    const __m512i mask512 = _mm512_set1_epi8((char)(0xFF >> SHIFT));
+    for (; n + 64 <= N; n += 64) {
+        const __m512i v = _mm512_loadu_si512((const void *)(src + n));
+        _mm512_storeu_si512((void *)(dst + n), _mm512_and_si512(_mm512_srli_epi16(v, SHIFT), mask512));
+    }
+#endif
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_set1_epi8((char)(0xFF >> SHIFT));
+    for (; n + 32 <= N; n += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(src + n));
+        _mm256_storeu_si256((__m256i *)(dst + n), _mm256_and_si256(_mm256_srli_epi16(v, SHIFT), mask256));
+    }
+#endif
+    for (; n < N; n++)
+        dst[n] = quantize<BINS>(src[n]);
+}
+
+// Counts N contiguous pairs of bin numbers (< BINS) into lanes (J_HISTO_LANES consecutive histograms of
+// BINS*BINS counts). With AVX-512 (AVX2) 64 (32) pairs are loaded at a time and interleaved into 16-bit
+// words (a << 8 | b) with a single unpack; with fewer than 256 bins the word is then folded into the bin
+// index a * BINS + b. The indexes are scattered round-robin over the lanes.
+template <int BINS>
+inline void joint_histogram_bins(const uint8_t *input_ref, const uint8_t *input_flt, const size_t N, uint32_t *lanes) {
+    constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+    constexpr int SHIFT = bin_shift<BINS>();
+    size_t n = 0;
+
+#if defined(__AVX512BW__)
+    const __m512i low512 = _mm512_set1_epi16(BINS - 1);
+    auto fold512 = [&](const __m512i w) {
+        if constexpr (SHIFT == 0) return w;
+        return _mm512_or_si512(_mm512_andnot_si512(low512, _mm512_srli_epi16(w, SHIFT)), _mm512_and_si512(w, low512));
+    };
+    alignas(64) uint16_t bins[64];
+    for (; n + 64 <= N; n += 64) {
+        const __m512i a = _mm512_loadu_si512((const void *)(input_ref + n));
+        const __m512i b = _mm512_loadu_si512((const void *)(input_flt + n));
+        _mm512_store_si512((void *)bins, fold512(_mm512_unpacklo_epi8(b, a)));
+        _mm512_store_si512((void *)(bins + 32), fold512(_mm512_unpackhi_epi8(b, a)));
+        for (int l = 0; l < 64; l += J_HISTO_LANES)
+            for (int lane = 0; lane < J_HISTO_LANES; lane++)
+                lanes[lane * HISTOGRAM_BINS + bins[l + lane]]++;
+    }
+#elif defined(__AVX2__)
+    const __m256i low256 = _mm256_set1_epi16(BINS - 1);
+    auto fold256 = [&](const __m256i w) {
+        if constexpr (SHIFT == 0) return w;
+        return _mm256_or_si256(_mm256_andnot_si256(low256, _mm256_srli_epi16(w, SHIFT)), _mm256_and_si256(w, low256));
+    };
+    alignas(32) uint16_t bins[32];
+    for (; n + 32 <= N; n += 32) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(input_ref + n));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(input_flt + n));
+        _mm256_store_si256((__m256i *)bins, fold256(_mm256_unpacklo_epi8(b, a)));
+        _mm256_store_si256((__m256i *)(bins + 16), fold256(_mm256_unpackhi_epi8(b, a)));
+        for (int l = 0; l < 32; l += J_HISTO_LANES)
+            for (int lane = 0; lane < J_HISTO_LANES; lane++)
+                lanes[lane * HISTOGRAM_BINS + bins[l + lane]]++;
+    }
+#endif
+
+    for (; n < N; n++) {
+        const unsigned int a = input_ref[n];
+        const unsigned int b = input_flt[n];
+        lanes[(n % J_HISTO_LANES) * HISTOGRAM_BINS + a * BINS + b]++;
+    }
+}
+
+// Counts N contiguous voxel pairs into lanes (J_HISTO_LANES consecutive histograms of BINS*BINS counts).
+// With fewer than 256 bins the intensities go through the quantization pre-pass one block at a time first.
+template <int BINS = J_HISTO_ROWS>
+inline void joint_histogram_run(const uint8_t *input_ref, const uint8_t *input_flt, const size_t N, uint32_t *lanes) {
+    if constexpr (BINS == 256) {
+        joint_histogram_bins<BINS>(input_ref, input_flt, N, lanes);
+    } else {
+        // a multiple of 64 pairs, so that the blocks keep the round-robin lane order of a single run
+        constexpr size_t BLOCK = 1024;
+        alignas(64) uint8_t ref_bins[BLOCK];
+        alignas(64) uint8_t flt_bins[BLOCK];
+        for (size_t n = 0; n < N; n += BLOCK) {
+            const size_t count = std::min(BLOCK, N - n);
+            quantize_run<BINS>(input_ref + n, ref_bins, count);
+            quantize_run<BINS>(input_flt + n, flt_bins, count);
+            joint_histogram_bins<BINS>(ref_bins, flt_bins, count, lanes);
+        }
+    }
+}
+
+// Folds the J_HISTO_LANES sub-histograms of lanes (BINS*BINS counts each) into j_h
+template <int BINS = J_HISTO_ROWS>
+inline void fold_lanes(const uint32_t *lanes, uint32_t *j_h) {
+    constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+    for (size_t b = 0; b < HISTOGRAM_BINS; b++) {
+        uint32_t count = 0;
+        for (int lane = 0; lane < J_HISTO_LANES; lane++)
+            count += lanes[(size_t)lane * HISTOGRAM_BINS + b];
+        j_h[b] = count;
+    }
+}
+
+// Accumulates into j_h (BINS x BINS counts, [ref][flt]) the voxel pairs of rows
+// [ROW_BEGIN, ROW_END) of two volumes stored with the interleaved layout (index = i*SIZE*LAYERS + j*LAYERS + k).
+// Only the first DEPTH slices of each column are counted, the remaining LAYERS-DEPTH are padding.
+// The volumes are read in memory order: a whole slab at once when there is no padding, column by column otherwise.
+// lanes is scratch memory for J_HISTO_LANES histograms; nullptr allocates it for this call only.
+template <int BINS = J_HISTO_ROWS>
+inline void joint_histogram_rows(
+    const uint8_t *input_ref, const uint8_t *input_flt, uint32_t *j_h,
+    const int SIZE, const int LAYERS, const int DEPTH,
+    const int ROW_BEGIN, const int ROW_END,
+    uint32_t *lanes = nullptr
+) {
+    constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+
+    std::vector<uint32_t> local_lanes;
+    if (lanes == nullptr) {
+        local_lanes.resize((size_t)J_HISTO_LANES * HISTOGRAM_BINS);
+        lanes = local_lanes.data();
+    }
+    // j_h is lane 0, the other lanes are folded into it at the end
+    std::memcpy(lanes, j_h, HISTOGRAM_BINS * sizeof(uint32_t));
+    std::memset(lanes + HISTOGRAM_BINS, 0, (J_HISTO_LANES - 1) * HISTOGRAM_BINS * sizeof(uint32_t));
+
+    const size_t first = (size_t)ROW_BEGIN * SIZE * LAYERS;
+    if (DEPTH == LAYERS) {
+        joint_histogram_run<BINS>(input_ref + first, input_flt + first, (size_t)(ROW_END - ROW_BEGIN) * SIZE * LAYERS, lanes);
+    } else {
+        for (size_t column = first; column < (size_t)ROW_END * SIZE * LAYERS; column += LAYERS)
+            joint_histogram_run<BINS>(input_ref + column, input_flt + column, DEPTH, lanes);
+    }
+
+    fold_lanes<BINS>(lanes, j_h);
+}
+
+// Scratch memory of the joint histograms, kept by the caller across evaluations so that they do not allocate:
+// the private histograms of workers 1..N-1, the sub-histogram lanes of every worker and, for the histograms
+// of warped volumes, the warped columns of every worker. Buffers only grow.
+struct JointHistogramWorkspace {
+    std::vector<uint32_t> private_histograms;
+    std::vector<uint32_t> lanes;
+    std::vector<uint8_t> columns;
+
+    uint32_t *private_histograms_for(const size_t count) { return reserve(private_histograms, count); }
+    uint32_t *lanes_for(const size_t count) { return reserve(lanes, count); }
+    uint8_t *columns_for(const size_t count) { return reserve(columns, count); }
+
+private:
+    template <typename T>
+    static T *reserve(std::vector<T> &buffer, const size_t count) {
+        if (buffer.size() < count) buffer.resize(count);
+        return buffer.data();
+    }
+};
+
+// Runs fill(local_histograms, row_begin, row_end) (or fill(worker, local_histograms, row_begin, row_end))
+// over N_THREADS contiguous slabs of N_ROWS rows, each worker on N_HISTOGRAMS private zeroed histograms of BINS*BINS counts, then merges the private histograms
+// into j_h (N_HISTOGRAMS consecutive histograms) pairwise in a fixed binary-tree order (0+1, 2+3, ... then
+// 0+2, ...), so the result never depends on thread scheduling.
+// workspace = nullptr allocates the private histograms for this call only.
+template <int BINS = J_HISTO_ROWS, typename Fill>
+void parallel_joint_histograms(uint32_t *j_h, const int N_HISTOGRAMS, const int N_ROWS, int N_THREADS, Fill fill,
+                               JointHistogramWorkspace *workspace = nullptr) {
+    const size_t STRIDE = (size_t)N_HISTOGRAMS * BINS * BINS;
+    auto fill_slab = [&](int t, uint32_t *local, int row_begin, int row_end) {
+        if constexpr (std::is_invocable_v<Fill &, int, uint32_t *, int, int>) fill(t, local, row_begin, row_end);
+        else fill(local, row_begin, row_end);
+    };
+    N_THREADS = std::max(1, std::min(N_THREADS, N_ROWS));
+    if (N_THREADS == 1) {
+        std::memset(j_h, 0, STRIDE * sizeof(uint32_t));
+        fill_slab(0, j_h, 0, N_ROWS);
+        return;
+    }
+
+    // the histograms of worker 0 are the output buffer itself, the others are private to their worker
+    JointHistogramWorkspace local_workspace;
+    if (workspace == nullptr) workspace = &local_workspace;
+    uint32_t *private_histograms = workspace->private_histograms_for((size_t)(N_THREADS - 1) * STRIDE);
+    auto histograms_of = [&](int t) {
+        return t == 0 ? j_h : private_histograms + (size_t)(t - 1) * STRIDE;
+    };
+
+    parallel_for_slabs(N_ROWS, N_THREADS, [&](int t, int row_begin, int row_end) {
+        uint32_t *local = histograms_of(t);
+        std::memset(local, 0, STRIDE * sizeof(uint32_t));
+        fill_slab(t, local, row_begin, row_end);
+    });
+
+    // tree reduction, parallelized over bins
+    parallel_for_slabs((int)STRIDE, N_THREADS, [&](int, int bin_begin, int bin_end) {
+        for (int stride = 1; stride < N_THREADS; stride *= 2) {
+            for (int t = 0; t + stride < N_THREADS; t += 2 * stride) {
+                uint32_t *dst = histograms_of(t);
+                const uint32_t *src = histograms_of(t + stride);
+                for (int b = bin_begin; b < bin_end; b++)
+                    dst[b] += src[b];
+            }
+        }
+    });
+}
+
+template <int BINS = J_HISTO_ROWS, typename Fill>
+void parallel_joint_histogram(uint32_t *j_h, const int N_ROWS, const int N_THREADS, Fill fill,
+                              JointHistogramWorkspace *workspace = nullptr) {
+    parallel_joint_histograms<BINS>(j_h, 1, N_ROWS, N_THREADS, fill, workspace);
+}
+
+// Builds the integer joint histogram (BINS x BINS) of two volumes with N_THREADS workers over row slabs.
+// Callers that build many histograms pass a workspace; nullptr allocates the scratch memory for this call only.
+template <int BINS = J_HISTO_ROWS>
+inline void joint_histogram_3d(
+    const uint8_t *input_ref, const uint8_t *input_flt, uint32_t *j_h,
+    const int SIZE, const int LAYERS, const int DEPTH,
+    int N_THREADS = sw_num_threads(),
+    JointHistogramWorkspace *workspace = nullptr
+) {
+    constexpr size_t LANES = (size_t)J_HISTO_LANES * BINS * BINS;
+    JointHistogramWorkspace local_workspace;
+    if (workspace == nullptr) workspace = &local_workspace;
+    const int N_WORKERS = std::max(1, std::min(N_THREADS, SIZE));
+    uint32_t *lanes = workspace->lanes_for(N_WORKERS * LANES);
+    parallel_joint_histogram<BINS>(j_h, SIZE, N_WORKERS, [&](int worker, uint32_t *local, int row_begin, int row_end) {
+        joint_histogram_rows<BINS>(input_ref, input_flt, local, SIZE, LAYERS, DEPTH, row_begin, row_end,
+                                   lanes + worker * LANES);
+    }, workspace);
+}
@@ -0,0 +1,96 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "voxel_sample.hpp"
+
+// In-plane downsampled copy of a SIZE x SIZE x LAYERS volume: every FACTOR x FACTOR block of a layer is
+// replaced by its rounded mean, the layers are left untouched. Returns a (SIZE/FACTOR)^2 x LAYERS volume.
+inline std::vector<uint8_t> downsample_volume(const uint8_t *volume, const int SIZE, const int LAYERS, const int FACTOR) {
+    const int OUT_SIZE = SIZE / FACTOR;
+    const int AREA = FACTOR * FACTOR;
+    std::vector<uint8_t> out((size_t)OUT_SIZE * OUT_SIZE * LAYERS);
+    std::vector<uint32_t> sums(LAYERS);
+    for (int row = 0; row < OUT_SIZE; row++) {
+        for (int col = 0; col < OUT_SIZE; col++) {
+            std::fill(sums.begin(), sums.end(), 0);
+            for (int r = row * FACTOR; r < (row + 1) * FACTOR; r++)
+                for (int c = col * FACTOR; c < (col + 1) * FACTOR; c++) {
+                    const uint8_t *column = volume + ((size_t)r * SIZE + c) * LAYERS;
+                    for (int k = 0; k < LAYERS; k++)
+                        sums[k] += column[k];
+                }
+            uint8_t *column = out.data() + ((size_t)row * OUT_SIZE + col) * LAYERS;
+            for (int k = 0; k < LAYERS; k++)
+                column[k] = (sums[k] + AREA / 2) / AREA;
+        }
+    }
+    return out;
+}
+
+// one downsampled level of the registration pyramid
+struct PyramidLevel {
+    int factor;
+    int size;
+    std::vector<uint8_t> ref;
+    std::vector<uint8_t> flt;
+};
+
+// Downsampling factors of the coarse-to-fine registration, coarsest first. Only factors > 1 dividing SIZE
+// are kept; empty = register directly at full resolution.
+inline std::vector<int> &registration_pyramid_setting() {
+    static std::vector<int> factors;
+    return factors;
+}
+
+inline void set_registration_pyramid(const std::vector<int> &factors) {
+    registration_pyramid_setting() = factors;
+}
+
+// the runtime setting takes precedence over the REG_PYRAMID environment variable (e.g. REG_PYRAMID=4,2)
+inline std::vector<int> registration_pyramid(const int SIZE) {
+    std::vector<int> factors = registration_pyramid_setting();
+    if (factors.empty()) {
+        if (const char *env = std::getenv("REG_PYRAMID"))
+            for (double f : parse_sw_mi_schedule(env))
+                factors.push_back((int)f);
+    }
+    factors.erase(std::remove_if(factors.begin(), factors.end(), [SIZE](int f) { return f <= 1 || SIZE % f != 0; }), factors.end());
+    std::sort(factors.begin(), factors.end(), std::greater<int>());
+    factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+    return factors;
+}
+
+// the downsampled levels are built once per registration, from the full-resolution buffers
+inline std::vector<PyramidLevel> build_pyramid(const uint8_t *ref, const uint8_t *flt, const int SIZE, const int LAYERS, const std::vector<int> &factors) {
+    std::vector<PyramidLevel> levels;
+    for (int factor : factors)
+        levels.push_back({factor, SIZE / factor, downsample_volume(ref, SIZE, LAYERS, factor), downsample_volume(flt, SIZE, LAYERS, factor)});
+    return levels;
+}
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "constants.h"
+#include "entropy.hpp"
+#include "foreground_index.hpp"
+#include "joint_histogram.hpp"
+#include "../image_utils/image_utils.hpp"
+
+// Reference-side data of a registration, computed once and shared by all the MI evaluations: the reference
+// never changes while the optimizer moves the floating volume, so its marginal histogram, its entropy and
+// its foreground (with the floating bounding box) are not recomputed per evaluation. The counters record
+// how many reference passes were avoided that way. The context also keeps the coordinate maps of the recent
+// angles, so the tx and ty line searches do not recompute the rotated source positions, and the scratch memory
+// of the joint histograms, so an evaluation does not allocate it.
+struct RegistrationContext {
+    const uint8_t *ref = nullptr;
+    uint8_t *flt = nullptr;
+    int SIZE = 0;
+    int DEPTH = 0;
+    int PADDING = 0;
+    int bins = J_HISTO_ROWS;
+
+    std::vector<uint32_t> ref_marginal;  // bins counts over SIZE*SIZE*DEPTH voxels
+    double ref_nlogn = 0.0;              // sum c*log2(c) over ref_marginal
+    double ref_entropy = 0.0;            // bits
+    bool sparse = false;
+    ForegroundIndex foreground;          // reference runs + floating bounding box (when sparse)
+    CoordinateMapCache coordinate_maps;  // rotated source positions of the recent angles
+    JointHistogramWorkspace histogram_workspace;  // scratch memory of the evaluations
+
+    // statistics
+    uint64_t evaluations = 0;            // candidate transforms evaluated
+    uint64_t marginal_passes_avoided = 0;  // reference marginals taken from the cache
+    uint64_t foreground_passes_avoided = 0;  // evaluations that reused the foreground index
+    uint64_t shifted_evaluations = 0;    // integer translations without rotation (no interpolation)
+
+    int layers() const { return DEPTH + PADDING; }
+    uint64_t voxels() const { return (uint64_t)SIZE * SIZE * DEPTH; }
+
+    void print_stats(std::ostream &os = std::cout) const {
+        os << "Registration context: " << evaluations << " evaluations, " << marginal_passes_avoided
+           << " reference marginal passes and " << foreground_passes_avoided << " foreground scans avoided; "
+           << coordinate_maps.misses << " coordinate maps built, " << coordinate_maps.hits << " reused, "
+           << shifted_evaluations << " pure translations" << std::endl;
+    }
+};
+
+// bin counts of the first DEPTH slices of a SIZE x SIZE x LAYERS volume, quantized as in quantize<BINS>()
+template <int BINS>
+inline void count_marginal(const uint8_t *volume, std::vector<uint32_t> &marginal, const int SIZE, const int LAYERS, const int DEPTH) {
+    marginal.assign(BINS, 0);
+    for (size_t column = 0; column < (size_t)SIZE * SIZE; column++)
+        for (int k = 0; k < DEPTH; k++)
+            marginal[quantize<BINS>(volume[column * LAYERS + k])]++;
+}
+
+// BINS must be 256, 128, 64 or 32 (see quantize<BINS>())
+inline RegistrationContext make_registration_context(const uint8_t *ref, uint8_t *flt, const int SIZE, const int DEPTH, const int PADDING, const int BINS = J_HISTO_ROWS, const bool SPARSE = true) {
+    RegistrationContext context;
+    context.ref = ref;
+    context.flt = flt;
+    context.SIZE = SIZE;
+    context.DEPTH = DEPTH;
+    context.PADDING = PADDING;
+    context.bins = BINS;
+
+    const int LAYERS = DEPTH + PADDING;
+    switch (BINS) {
+        case 128: count_marginal<128>(ref, context.ref_marginal, SIZE, LAYERS, DEPTH); break;
+        case 64:  count_marginal<64>(ref, context.ref_marginal, SIZE, LAYERS, DEPTH); break;
+        case 32:  count_marginal<32>(ref, context.ref_marginal, SIZE, LAYERS, DEPTH); break;
+        default:  count_marginal<256>(ref, context.ref_marginal, SIZE, LAYERS, DEPTH); break;
+    }
+    context.ref_nlogn = sum_nlogn(context.ref_marginal.data(), BINS);
+    context.ref_entropy = entropy_from_counts(context.ref_marginal.data(), BINS, context.voxels());
+
+    context.sparse = SPARSE;
+    if (SPARSE)
+        context.foreground = build_foreground_index(ref, flt, SIZE, LAYERS, DEPTH);
+    return context;
+}
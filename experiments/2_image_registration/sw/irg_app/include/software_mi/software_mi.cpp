@@ -24,179 +24,219 @@ SOFTWARE.
 
 #include "software_mi.hpp"
 
-static double sw_registration_step_3d(uint8_t* input_ref, uint8_t* input_flt, uint8_t* output_flt, int n_couples, const int TX, const int TY, const float ANG,int depth, int padding){
-    transform_volume(input_flt, output_flt, TX, TY, ANG, DIMENSION, (depth+padding),MODE_BILINEAR);
-    
-    double j_h[J_HISTO_ROWS][J_HISTO_COLS];
-    for(int i=0;i<J_HISTO_ROWS;i++){
-        for(int j=0;j<J_HISTO_COLS;j++){
-            j_h[i][j]=0.0;
-        }
-    }
+// mutual information of an integer BINS x BINS joint histogram built over N_VOXELS voxel pairs
+template <int BINS>
+static double sw_mutual_information(const uint32_t* j_h_counts, const int N_VOXELS){
+   // entropies straight from the integer counts: H = log2(N) - sum c*log2(c)/N
+   // N_VOXELS counts only the DEPTH real slices, the padding layers are never binned
+   return mutual_information_from_counts<BINS>(j_h_counts, N_VOXELS);
+}
 
+// mutual information between the reference and the already-transformed floating volume
+static double sw_mutual_information_3d(const uint8_t* input_ref, const uint8_t* output_flt, int depth, int padding){
    const int N_COUPLES_TOTAL = depth + padding;
 
-   for(int k = 0; k < N_COUPLES_TOTAL-padding; k++) {
-      for(int i=0;i<DIMENSION;i++){
-         for(int j=0;j<DIMENSION;j++){
-               unsigned int a=input_ref[i * DIMENSION * (N_COUPLES_TOTAL) + j * (N_COUPLES_TOTAL) + k];
-               unsigned int b=output_flt[i * DIMENSION * (N_COUPLES_TOTAL) + j * (N_COUPLES_TOTAL) + k];
-               j_h[a][b]= (j_h[a][b])+1;
-         }
-      }
-   }
-
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         j_h[i][j] = j_h[i][j]/((N_COUPLES_TOTAL-padding)*DIMENSION*DIMENSION); // per versal = dividere per n_couples anziché n_couples+padding
-      }
-   }
-
-   float entropy = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         float v = j_h[j][i];
-         if (v > 0.000000000000001) {
-         entropy += v*log2(v);///log(2);
-         }
-      }
-   }
-   entropy *= -1;
-
-   double href[J_HISTO_ROWS];
-   for(int i=0;i<J_HISTO_ROWS;i++){
-      href[i]=0.0;
-   }
-
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_ROWS; j++) {
-         href[i] += j_h[i][j];
-      }
-   }
-
-   double hflt[J_HISTO_ROWS];
-   for(int i=0;i<J_HISTO_ROWS;i++){
-      hflt[i]=0.0;
-   }
-
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         hflt[i] += j_h[j][i];
-      }
-   }
-
-
-   double eref = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      if (href[i] > 0.000000000001) {
-         eref += href[i] * log2(href[i]);///log(2);
-      }
-   }
-   eref *= -1;
-
-   double eflt = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      if (hflt[i] > 0.000000000001) {
-         eflt += hflt[i] * log2(hflt[i]);///log(2);
-      }
-   }
-   eflt =  eflt * (-1);
-
-   double mutualinfo = eref + eflt - entropy;
-   //delete[] output_flt;
-   return mutualinfo;
-
+   // the joint histogram is built in parallel over row slabs; integer counts make the result
+   // independent of the number of threads
+   std::vector<uint32_t> j_h(J_HISTO_BINS);
+   joint_histogram_3d(input_ref, output_flt, j_h.data(), DIMENSION, N_COUPLES_TOTAL, depth);
 
+   return sw_mutual_information(j_h.data(), (N_COUPLES_TOTAL-padding)*DIMENSION*DIMENSION);
 }
 
-static double sw_registration_step_3d(uint8_t* input_ref, uint8_t* input_flt,int n_couples, const int TX, const int TY, const float ANG,int depth, int padding){
-    
-    uint8_t* output_flt = new uint8_t[DIMENSION*DIMENSION * (depth+padding)];
-    transform_volume(input_flt, output_flt, TX, TY, ANG, DIMENSION, (depth+padding),MODE_BILINEAR);
-    // Calcolo della MI
-    double j_h[J_HISTO_ROWS][J_HISTO_COLS];
-    for(int i=0;i<J_HISTO_ROWS;i++){
-        for(int j=0;j<J_HISTO_COLS;j++){
-            j_h[i][j]=0.0;
-        }
-    }
-
-   const int N_COUPLES_TOTAL = depth + padding;
-
-   for(int k = 0; k < N_COUPLES_TOTAL-padding; k++) {
-      for(int i=0;i<DIMENSION;i++){
-         for(int j=0;j<DIMENSION;j++){
-               unsigned int a=input_ref[i * DIMENSION * (N_COUPLES_TOTAL) + j * (N_COUPLES_TOTAL) + k];
-               unsigned int b=output_flt[i * DIMENSION * (N_COUPLES_TOTAL) + j * (N_COUPLES_TOTAL) + k];
-               j_h[a][b]= (j_h[a][b])+1;
-         }
+// Joint histograms of the reference against the floating volume warped by each of the N_CANDIDATES
+// transforms (j_h holds N_CANDIDATES consecutive histograms). Every reference voxel is read once and
+// binned into all the histograms, so the reference stream is shared by the whole batch.
+// With a foreground index only the reference runs and the columns the floating foreground can be
+// warped onto are visited; every other voxel is a (0, 0) pair and is added to bin [0][0] in bulk,
+// so the counts are the same as the dense pass.
+// With a voxel sample only the sampled columns are binned (sample->columns * DEPTH pairs per histogram).
+// Each histogram has BINS x BINS counts; the intensities are quantized as in quantize<BINS>().
+// Candidates with an integer translation and no rotation copy the shifted floating columns; with a coordinate map
+// cache the other integer translations take their source positions from the map of their angle (same counts).
+// The pairs are binned by joint_histogram_run into per-worker sub-histograms; workspace = nullptr allocates the
+// scratch memory for this call only.
+template <int BINS>
+static void sw_warped_joint_histograms_3d(const uint8_t* input_ref, uint8_t* input_flt, uint32_t* j_h, const rigid_transform* candidates, const int N_CANDIDATES, const int SIZE, const int LAYERS, const int DEPTH, const ForegroundIndex* foreground, const VoxelSample* sample, CoordinateMapCache* maps, JointHistogramWorkspace* workspace){
+   const VoxelSample full = build_voxel_sample(SIZE, 1.0);
+   if (sample == nullptr) sample = &full;
+   const int stride = sample->stride;
+   constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+   std::vector<float> cosines(N_CANDIDATES), sines(N_CANDIDATES);
+   std::vector<bool> shifted(N_CANDIDATES);
+   std::vector<std::shared_ptr<const CoordinateMap>> coordinate_maps(N_CANDIDATES);
+   for (int c = 0; c < N_CANDIDATES; c++) {
+      const rigid_transform& t = candidates[c];
+      cosines[c] = std::cos(t.ang);
+      sines[c] = std::sin(t.ang);
+      const bool integer = is_integer_translation(t.tx, t.ty);
+      shifted[c] = integer && t.ang == 0.f;
+      if (maps && integer && !shifted[c]) {
+         std::shared_ptr<const CoordinateMap> map = maps->get(t.ang, SIZE);
+         if (map->covers((int)t.tx, (int)t.ty)) coordinate_maps[c] = map;
       }
    }
-
-   //j_h[0][0] = j_h[0][0] - padding*DIMENSION*DIMENSION; // per versal = sottrarre i valori in j_h dovuti al padding
-
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         j_h[i][j] = j_h[i][j]/((N_COUPLES_TOTAL-padding)*DIMENSION*DIMENSION); // per versal = dividere per n_couples anziché n_couples+padding
+   auto warp_column = [&](const int c, const int col, const int row, uint8_t* dest) {
+      const rigid_transform& t = candidates[c];
+      if (shifted[c]) {
+         const int offset = shifted_column(t.tx, t.ty, SIZE, LAYERS, col, row);
+         if (offset < 0) std::memset(dest, 0, DEPTH);
+         else std::memcpy(dest, input_flt + offset, DEPTH);
+      } else if (coordinate_maps[c]) {
+         blend_column(input_flt, bilinear_column(*coordinate_maps[c], t.tx, t.ty, LAYERS, col, row), dest, DEPTH);
+      } else {
+         blend_column(input_flt, bilinear_column(t.tx, t.ty, cosines[c], sines[c], SIZE, LAYERS, col, row), dest, DEPTH);
       }
-   }
-
-
-   float entropy = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         float v = j_h[j][i];
-         if (v > 0.000000000000001) {
-         entropy += v*log2(v);///log(2);
+   };
+
+   // per worker: the J_HISTO_LANES sub-histograms of every candidate and one row of warped columns per candidate,
+   // taken from the workspace so that an evaluation does not allocate
+   constexpr size_t LANES = (size_t)J_HISTO_LANES * HISTOGRAM_BINS;
+   const int N_WORKERS = std::max(1, std::min(sw_num_threads(), SIZE));
+   const size_t WORKER_LANES = (size_t)N_CANDIDATES * LANES;
+   const size_t ROW_BYTES = (size_t)SIZE * DEPTH;
+   JointHistogramWorkspace local_workspace;
+   if (workspace == nullptr) workspace = &local_workspace;
+   uint32_t* lanes = workspace->lanes_for(N_WORKERS * WORKER_LANES);
+   uint8_t* columns = workspace->columns_for(N_WORKERS * N_CANDIDATES * ROW_BYTES);
+   // without padding and sampling the reference columns of a span are contiguous, and so are the warped ones
+   const bool contiguous = DEPTH == LAYERS && stride == 1;
+
+   parallel_joint_histograms<BINS>(j_h, N_CANDIDATES, SIZE, N_WORKERS, [&](int worker, uint32_t* local, int row_begin, int row_end){
+      uint32_t* worker_lanes = lanes + worker * WORKER_LANES;
+      uint8_t* warped = columns + (size_t)worker * N_CANDIDATES * ROW_BYTES;
+      std::memset(worker_lanes, 0, WORKER_LANES * sizeof(uint32_t));
+
+      // each candidate warps the whole depth columns of the span (see blend_column) into its row buffer, then
+      // joint_histogram_run bins them, as a single run when the span is contiguous
+      auto bin_columns = [&](const int row, const int col_begin, const int col_end) {
+         const int first = sample->first_column(row, col_begin);
+         if (first >= col_end) return;
+         for (int c = 0; c < N_CANDIDATES; c++) {
+            uint8_t* dest = warped + c * ROW_BYTES;
+            for (int col = first; col < col_end; col += stride, dest += DEPTH)
+               warp_column(c, col, row, dest);
+         }
+         if (contiguous) {
+            const uint8_t* ref = input_ref + ((size_t)row * SIZE + first) * LAYERS;
+            for (int c = 0; c < N_CANDIDATES; c++)
+               joint_histogram_run<BINS>(ref, warped + c * ROW_BYTES, (size_t)(col_end - first) * DEPTH, worker_lanes + c * LANES);
+            return;
+         }
+         size_t offset = 0;
+         for (int col = first; col < col_end; col += stride, offset += DEPTH) {
+            const uint8_t* ref = input_ref + ((size_t)row * SIZE + col) * LAYERS;
+            for (int c = 0; c < N_CANDIDATES; c++)
+               joint_histogram_run<BINS>(ref, warped + c * ROW_BYTES + offset, DEPTH, worker_lanes + c * LANES);
+         }
+      };
+
+      uint32_t skipped = 0;
+      if (foreground == nullptr) {
+         for (int row = row_begin; row < row_end; row++)
+            bin_columns(row, 0, SIZE);
+      } else {
+         std::vector<ColumnRun> spans;
+         for (int row = row_begin; row < row_end; row++) {
+            spans.assign(foreground->runs.begin() + foreground->row_offsets[row], foreground->runs.begin() + foreground->row_offsets[row + 1]);
+            for (int c = 0; c < N_CANDIDATES; c++) {
+               ColumnRun span;
+               if (floating_span(*foreground, candidates[c].tx, candidates[c].ty, candidates[c].ang, row, span))
+                  spans.push_back(span);
+            }
+            std::sort(spans.begin(), spans.end(), [](const ColumnRun& x, const ColumnRun& y) { return x.begin < y.begin; });
+
+            // visit the union of the spans once
+            int visited_end = 0;
+            for (const ColumnRun& span : spans) {
+               const int begin = std::max(span.begin, visited_end);
+               if (begin >= span.end) continue;
+               skipped += sample->count_columns(row, visited_end, begin) * DEPTH;
+               bin_columns(row, begin, span.end);
+               visited_end = span.end;
+            }
+            skipped += sample->count_columns(row, visited_end, SIZE) * DEPTH;
          }
       }
-   }
-   entropy *= -1;
 
-   double href[J_HISTO_ROWS];
-   for(int i=0;i<J_HISTO_ROWS;i++){
-      href[i]=0.0;
-   }
-
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_ROWS; j++) {
-         href[i] += j_h[i][j];
+      for (int c = 0; c < N_CANDIDATES; c++) {
+         fold_lanes<BINS>(worker_lanes + c * LANES, local + c * HISTOGRAM_BINS);
+         local[c * HISTOGRAM_BINS] += skipped;
       }
-   }
-
-   double hflt[J_HISTO_ROWS];
-   for(int i=0;i<J_HISTO_ROWS;i++){
-      hflt[i]=0.0;
-   }
+   }, workspace);
+}
 
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      for (int j=0; j<J_HISTO_COLS; j++) {
-         hflt[i] += j_h[j][i];
-      }
-   }
+// MI of a SIZE x SIZE x (depth+padding) reference against the floating volume for a batch of candidate
+// transforms (one pass over the reference), with BINS x BINS joint histograms
+template <int BINS>
+static std::vector<double> sw_mutual_information_batch(const uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, const int SIZE, int depth, int padding, const ForegroundIndex* foreground, const VoxelSample* sample){
+    const int N_CANDIDATES = candidates.size();
+    constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+    std::vector<uint32_t> j_h(N_CANDIDATES * HISTOGRAM_BINS);
+    sw_warped_joint_histograms_3d<BINS>(input_ref, input_flt, j_h.data(), candidates.data(), N_CANDIDATES, SIZE, depth+padding, depth, foreground, sample);
+
+    const int N_VOXELS = depth * (sample ? (int)sample->columns : SIZE*SIZE);
+    std::vector<double> mutualinfo(N_CANDIDATES);
+    for (int c = 0; c < N_CANDIDATES; c++)
+        mutualinfo[c] = sw_mutual_information<BINS>(j_h.data() + c * HISTOGRAM_BINS, N_VOXELS);
+    return mutualinfo;
+}
 
+// MI of the context's reference against its floating volume for a batch of candidate transforms. At full
+// resolution the reference term comes from the context and only the floating marginal is accumulated;
+// a voxel sample changes the reference counts, so sampled evaluations take it from the joint histograms.
+template <int BINS>
+static std::vector<double> sw_mutual_information_batch(RegistrationContext& context, const std::vector<rigid_transform>& candidates, const VoxelSample* sample){
+    const int N_CANDIDATES = candidates.size();
+    constexpr size_t HISTOGRAM_BINS = (size_t)BINS * BINS;
+    std::vector<uint32_t> j_h(N_CANDIDATES * HISTOGRAM_BINS);
+    const ForegroundIndex* foreground = context.sparse ? &context.foreground : nullptr;
+    sw_warped_joint_histograms_3d<BINS>(context.ref, context.flt, j_h.data(), candidates.data(), N_CANDIDATES, context.SIZE, context.layers(), context.DEPTH, foreground, sample, &context.coordinate_maps, &context.histogram_workspace);
+
+    std::vector<double> mutualinfo(N_CANDIDATES);
+    for (int c = 0; c < N_CANDIDATES; c++) {
+        const uint32_t* counts = j_h.data() + c * HISTOGRAM_BINS;
+        if (sample)
+            mutualinfo[c] = sw_mutual_information<BINS>(counts, context.DEPTH * sample->columns);
+        else
+            mutualinfo[c] = mutual_information_from_counts<BINS>(counts, context.voxels(), context.ref_nlogn);
+    }
 
-   double eref = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      if (href[i] > 0.000000000001) {
-         eref += href[i] * log2(href[i]);///log(2);
-      }
-   }
-   eref *= -1;
+    context.evaluations += N_CANDIDATES;
+    for (const rigid_transform& t : candidates)
+        context.shifted_evaluations += t.ang == 0.f && is_integer_translation(t.tx, t.ty);
+    if (!sample) context.marginal_passes_avoided += N_CANDIDATES;
+    if (foreground) context.foreground_passes_avoided += N_CANDIDATES;
+    return mutualinfo;
+}
 
+static std::vector<double> sw_mutual_information_batch(RegistrationContext& context, const std::vector<rigid_transform>& candidates, const VoxelSample* sample){
+    switch (context.bins) {
+        case 128: return sw_mutual_information_batch<128>(context, candidates, sample);
+        case 64:  return sw_mutual_information_batch<64>(context, candidates, sample);
+        case 32:  return sw_mutual_information_batch<32>(context, candidates, sample);
+        default:  return sw_mutual_information_batch<256>(context, candidates, sample);
+    }
+}
 
-   double eflt = 0.0;
-   for (int i=0; i<J_HISTO_ROWS; i++) {
-      if (hflt[i] > 0.000000000001) {
-         eflt += hflt[i] * log2(hflt[i]);///log(2);
-      }
-   }
-   eflt =  eflt * (-1);
+// sw_mutual_information_batch with the bin count chosen at runtime (256, 128, 64 or 32)
+static std::vector<double> sw_mutual_information_batch(const int BINS, const uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, const int SIZE, int depth, int padding, const ForegroundIndex* foreground, const VoxelSample* sample){
+    switch (BINS) {
+        case 128: return sw_mutual_information_batch<128>(input_ref, input_flt, candidates, SIZE, depth, padding, foreground, sample);
+        case 64:  return sw_mutual_information_batch<64>(input_ref, input_flt, candidates, SIZE, depth, padding, foreground, sample);
+        case 32:  return sw_mutual_information_batch<32>(input_ref, input_flt, candidates, SIZE, depth, padding, foreground, sample);
+        default:  return sw_mutual_information_batch<256>(input_ref, input_flt, candidates, SIZE, depth, padding, foreground, sample);
+    }
+}
 
-   double mutualinfo = eref + eflt - entropy;
-   delete[] output_flt;
-   return mutualinfo;
+// MI of the reference against the floating volume for a batch of candidate transforms (one pass over the reference)
+static std::vector<double> sw_registration_step_3d_batch(uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, int depth, int padding, const ForegroundIndex* foreground, const VoxelSample* sample){
+    return sw_mutual_information_batch(input_ref, input_flt, candidates, DIMENSION, depth, padding, foreground, sample);
+}
 
+static double sw_registration_step_3d(uint8_t* input_ref, uint8_t* input_flt, uint8_t* output_flt, int n_couples, const int TX, const int TY, const float ANG,int depth, int padding){
+    transform_volume(input_flt, output_flt, TX, TY, ANG, DIMENSION, (depth+padding),MODE_BILINEAR);
+    return sw_mutual_information_3d(input_ref, output_flt, depth, padding);
 }
 
 
@@ -24,8 +24,33 @@ SOFTWARE.
 
 #pragma once
 #include <chrono>
+#include <vector>
 #include "../image_utils/image_utils.hpp"
 #include "constants.h"
+#include "joint_histogram.hpp"
+#include "entropy.hpp"
+#include "foreground_index.hpp"
+#include "voxel_sample.hpp"
+#include "pyramid.hpp"
+#include "registration_context.hpp"
 
+// in-plane rigid transform: translation (px) along x/y and rotation (rad) around z
+struct rigid_transform {
+    float tx;
+    float ty;
+    float ang;
+};
+
+template <int BINS = J_HISTO_ROWS>
+static double sw_mutual_information(const uint32_t* j_h_counts, const int N_VOXELS);
+static double sw_mutual_information_3d(const uint8_t* input_ref, const uint8_t* output_flt, int depth, int padding);
+template <int BINS = J_HISTO_ROWS>
+static void sw_warped_joint_histograms_3d(const uint8_t* input_ref, uint8_t* input_flt, uint32_t* j_h, const rigid_transform* candidates, const int N_CANDIDATES, const int SIZE, const int LAYERS, const int DEPTH, const ForegroundIndex* foreground = nullptr, const VoxelSample* sample = nullptr, CoordinateMapCache* maps = nullptr, JointHistogramWorkspace* workspace = nullptr);
 static double sw_registration_step_3d(uint8_t* input_ref, uint8_t* input_flt, uint8_t* output_flt, int n_couples, const int TX, const int TY, const float ANG,int depth, int padding);
-static double sw_registration_step_3d(uint8_t* input_ref, uint8_t* input_flt,int n_couples, const int TX, const int TY, const float ANG,int depth, int padding);
+template <int BINS = J_HISTO_ROWS>
+static std::vector<double> sw_mutual_information_batch(const uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, const int SIZE, int depth, int padding, const ForegroundIndex* foreground = nullptr, const VoxelSample* sample = nullptr);
+template <int BINS>
+static std::vector<double> sw_mutual_information_batch(RegistrationContext& context, const std::vector<rigid_transform>& candidates, const VoxelSample* sample = nullptr);
+static std::vector<double> sw_mutual_information_batch(RegistrationContext& context, const std::vector<rigid_transform>& candidates, const VoxelSample* sample = nullptr);
+static std::vector<double> sw_mutual_information_batch(const int BINS, const uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, const int SIZE, int depth, int padding, const ForegroundIndex* foreground = nullptr, const VoxelSample* sample = nullptr);
+static std::vector<double> sw_registration_step_3d_batch(uint8_t* input_ref, uint8_t* input_flt, const std::vector<rigid_transform>& candidates, int depth, int padding, const ForegroundIndex* foreground = nullptr, const VoxelSample* sample = nullptr);
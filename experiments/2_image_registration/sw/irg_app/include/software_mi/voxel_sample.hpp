@@ -0,0 +1,103 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// seed of the voxel subsample, so that sampled registrations are reproducible
+#ifndef SW_SAMPLE_SEED
+#define SW_SAMPLE_SEED 1234
+#endif
+
+// Stratified column subsample of a SIZE x SIZE plane: every row keeps one column out of STRIDE, starting
+// from a seeded per-row offset, and a kept column contributes all of its DEPTH voxels. The sample only
+// depends on (SIZE, fraction, seed), and it is defined row by row so the row slabs of the joint
+// histogram workers stay independent.
+struct VoxelSample {
+    int stride = 1;
+    std::vector<int> row_offsets;  // first kept column of every row, in [0, stride)
+    size_t columns = 0;            // kept columns over the whole plane
+
+    // first kept column of ROW not before BEGIN
+    int first_column(const int row, const int begin) const {
+        return begin + ((row_offsets[row] - begin) % stride + stride) % stride;
+    }
+
+    // kept columns of ROW in [BEGIN, END)
+    int count_columns(const int row, const int begin, const int end) const {
+        const int first = first_column(row, begin);
+        return first < end ? (end - first + stride - 1) / stride : 0;
+    }
+};
+
+inline VoxelSample build_voxel_sample(const int SIZE, const double fraction, const unsigned seed = SW_SAMPLE_SEED) {
+    VoxelSample sample;
+    sample.stride = std::max(1, std::min(SIZE, (int)std::lround(1.0 / std::max(fraction, 1e-6))));
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> offset(0, sample.stride - 1);
+    sample.row_offsets.resize(SIZE);
+    for (int row = 0; row < SIZE; row++) {
+        sample.row_offsets[row] = offset(generator);
+        sample.columns += sample.count_columns(row, 0, SIZE);
+    }
+    return sample;
+}
+
+// Sampling schedule of the software registration: entry i is the fraction of voxels used by the i-th
+// Powell sweep, the sweeps after the schedule run at full resolution until convergence. Empty = always
+// full resolution.
+inline std::vector<double> &sw_mi_schedule_setting() {
+    static std::vector<double> schedule;
+    return schedule;
+}
+
+inline void set_sw_mi_schedule(const std::vector<double> &schedule) {
+    sw_mi_schedule_setting() = schedule;
+}
+
+// parses a comma-separated list of fractions, e.g. "0.1,0.25"
+inline std::vector<double> parse_sw_mi_schedule(const std::string &text) {
+    std::vector<double> schedule;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            schedule.push_back(std::atof(item.c_str()));
+    return schedule;
+}
+
+// the runtime setting takes precedence over the SW_MI_SCHEDULE environment variable
+inline std::vector<double> sw_mi_schedule() {
+    if (!sw_mi_schedule_setting().empty())
+        return sw_mi_schedule_setting();
+    if (const char *env = std::getenv("SW_MI_SCHEDULE"))
+        return parse_sw_mi_schedule(env);
+    return {};
+}
@@ -0,0 +1,160 @@
+/*
+MIT License
+
+Copyright (c) 2025 Giuseppe Sorrentino, Paolo Salvatore Galfano, Davide Conficconi, Eleonora D'Arnese
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads used by the software registration path (0 = one per hardware thread)
+#ifndef SW_NUM_THREADS
+#define SW_NUM_THREADS 0
+#endif
+
+// the SW_THREADS environment variable takes precedence over the compile-time default
+inline int &sw_num_threads_setting() {
+    static int n_threads = []() {
+        if (const char *env = std::getenv("SW_THREADS"))
+            return std::max(0, std::atoi(env));
+        return std::max(0, SW_NUM_THREADS);
+    }();
+    return n_threads;
+}
+
+// overrides the number of worker threads at runtime (0 = one per hardware thread)
+inline void set_sw_num_threads(const int n_threads) {
+    sw_num_threads_setting() = std::max(0, n_threads);
+}
+
+inline int sw_num_threads() {
+    int n_threads = sw_num_threads_setting();
+    if (n_threads <= 0)
+        n_threads = (int)std::thread::hardware_concurrency();
+    return std::max(1, n_threads);
+}
+
+// Process-wide pool of persistent worker threads behind parallel_for_slabs. Workers are started on demand
+// (never more than the largest N_THREADS - 1 requested so far), wait on a shared task queue and are joined
+// at exit.
+class SlabWorkerPool {
+public:
+    static SlabWorkerPool &instance() {
+        static SlabWorkerPool pool;
+        return pool;
+    }
+
+    // true on the threads of the pool
+    static bool &on_worker() {
+        static thread_local bool worker = false;
+        return worker;
+    }
+
+    void reserve(const int n_workers) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while ((int)workers.size() < n_workers)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    ~SlabWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+private:
+    SlabWorkerPool() = default;
+
+    void work() {
+        on_worker() = true;
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stop || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stop = false;
+};
+
+// Splits [0, N_ITEMS) into N_THREADS contiguous slabs and runs body(thread_id, begin, end) on each.
+// The partitioning only depends on N_ITEMS and N_THREADS, so the work assigned to every
+// thread_id is the same from run to run. The calling thread executes slab 0, the other slabs run on the
+// persistent workers of SlabWorkerPool: a call costs one queued task and one wake-up per extra slab, not
+// a thread creation. Called from inside a slab (nested parallelism), all the slabs run in order on the
+// calling thread, so a worker never blocks on tasks queued behind it.
+template <typename Body>
+void parallel_for_slabs(const int N_ITEMS, int N_THREADS, Body body) {
+    N_THREADS = std::max(1, std::min(N_THREADS, N_ITEMS));
+    auto slab_begin = [&](int t) { return (int)((long long)N_ITEMS * t / N_THREADS); };
+    if (N_THREADS == 1 || SlabWorkerPool::on_worker()) {
+        for (int t = 0; t < N_THREADS; t++)
+            body(t, slab_begin(t), slab_begin(t + 1));
+        return;
+    }
+
+    SlabWorkerPool &pool = SlabWorkerPool::instance();
+    pool.reserve(N_THREADS - 1);
+    std::mutex done_mutex;
+    std::condition_variable done;
+    int pending = N_THREADS - 1;
+    for (int t = 1; t < N_THREADS; t++) {
+        pool.submit([&, t]() {
+            body(t, slab_begin(t), slab_begin(t + 1));
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--pending == 0)
+                done.notify_one();
+        });
+    }
+    body(0, slab_begin(0), slab_begin(1));
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&]() { return pending == 0; });
+}
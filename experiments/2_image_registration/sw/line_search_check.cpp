@@ -0,0 +1,91 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "irg_app/core/optimize.hpp"
+
+// =============================================================================
+// Check of the line searches: the k-section search must reach the minimum of
+// the golden-section search on functions with a known minimum
+// =============================================================================
+//
+// Every line search selected through set_line_search (golden section, k-section
+// with 2 to 7 probes set through set_ksection_probes, Brent) runs through
+// optimize_line and optimize_line_batch on smooth, flat, kinked and
+// bracket-bounded functions. Each result must be within 5 LINE_SEARCH_TOLERANCE
+// of the known minimum (the widest final bracket, that of k-section with 7
+// probes, spans 8 tolerances) and so within 10 of the golden-section result.
+// Exits with 1 on any miss.
+
+struct LineProblem {
+  std::string name;
+  double init, rng;
+  double minimum; // in the bracket [init - 0.382 rng, init + 0.618 rng]
+  std::function<double(double)> cost;
+};
+
+int main() {
+  const std::vector<LineProblem> problems = {
+      {"quadratic", 0.0, 5.0, 1.234, [](double x) { return (x - 1.234) * (x - 1.234); }},
+      {"quartic", 2.0, 3.0, 2.5, [](double x) { return std::pow(x - 2.5, 4); }},
+      {"kink", 0.0, 4.0, -0.7, [](double x) { return std::fabs(x + 0.7) + 0.1; }},
+      {"cosine", 0.0, 2.0, 0.3, [](double x) { return 1.0 - std::cos(x - 0.3); }},
+      // the minimum lies beyond the bracket: every search stops at its end
+      {"bracket end", 0.0, 2.0, 0.618 * 2.0, [](double x) { return (x - 5.0) * (x - 5.0); }},
+  };
+  const double TOLERANCE = 5 * LINE_SEARCH_TOLERANCE;
+
+  int checks = 0, failures = 0;
+  auto check = [&](const LineProblem &problem, const std::string &search, const double x, const double golden) {
+    checks++;
+    if (std::fabs(x - problem.minimum) > TOLERANCE || std::fabs(x - golden) > 2 * TOLERANCE) {
+      failures++;
+      std::cerr << "Miss: " << problem.name << ", " << search << ": " << x << " (minimum " << problem.minimum
+                << ", golden section " << golden << ")\n";
+    }
+  };
+
+  for (const LineProblem &problem : problems) {
+    int evaluations = 0;
+    auto function = [&](double x) {
+      evaluations++;
+      return problem.cost(x);
+    };
+    auto batch_function = [&](const std::vector<double> &xs) {
+      std::vector<double> costs;
+      for (const double x : xs)
+        costs.push_back(function(x));
+      return costs;
+    };
+
+    // evaluations of the optimize_line run of each search
+    set_line_search(GOLDEN_SECTION);
+    const double golden = optimize_line(problem.init, problem.rng, function);
+    std::cout << problem.name << ": golden section " << golden << " (" << evaluations << " evaluations)";
+    check(problem, "golden section", golden, golden);
+    check(problem, "golden section (batch)", optimize_line_batch(problem.init, problem.rng, batch_function), golden);
+
+    set_line_search(K_SECTION);
+    for (const int probes : {2, 3, 4, 5, 7}) {
+      set_ksection_probes(probes);
+      const std::string search = "k-section " + std::to_string(probes);
+      evaluations = 0;
+      const double x = optimize_line(problem.init, problem.rng, function);
+      std::cout << ", " << search << " " << x << " (" << evaluations << ")";
+      check(problem, search, x, golden);
+      check(problem, search + " (batch)", optimize_line_batch(problem.init, problem.rng, batch_function), golden);
+    }
+
+    set_line_search(BRENT);
+    evaluations = 0;
+    const double brent = optimize_line(problem.init, problem.rng, function);
+    std::cout << ", brent " << brent << " (" << evaluations << ")\n";
+    check(problem, "brent", brent, golden);
+    check(problem, "brent (batch)", optimize_line_batch(problem.init, problem.rng, batch_function), golden);
+  }
+
+  std::cout << checks - failures << " of " << checks << " line searches reach the minimum\n";
+  return failures == 0 ? 0 : 1;
+}
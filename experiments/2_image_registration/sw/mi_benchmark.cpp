@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
+#include "constants.h" // DIMENSION, J_HISTO_ROWS, J_HISTO_COLS
+#include "irg_app/include/software_mi/joint_histogram.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Throughput of the software joint histogram, in voxel pairs per second
+// =============================================================================
+
+// original k-outermost loop over a double histogram, kept as the baseline
+void joint_histogram_baseline(int n_couples, const uint8_t *input_ref,
+                              const uint8_t *input_flt,
+                              double (*j_h)[J_HISTO_COLS]) {
+  for (int i = 0; i < J_HISTO_ROWS; i++) {
+    for (int j = 0; j < J_HISTO_COLS; j++) {
+      j_h[i][j] = 0.0;
+    }
+  }
+  for (int k = 0; k < n_couples; k++) {
+    for (int i = 0; i < DIMENSION; i++) {
+      for (int j = 0; j < DIMENSION; j++) {
+        unsigned int a = input_ref[i * DIMENSION * n_couples + j * n_couples + k];
+        unsigned int b = input_flt[i * DIMENSION * n_couples + j * n_couples + k];
+        j_h[a][b] = (j_h[a][b]) + 1;
+      }
+    }
+  }
+}
+
+template <typename F> double time_runs(int runs, F function) {
+  function(); // warmup
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < runs; r++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count() / runs;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <PET_folder|-> <CT_folder|-> [depth] [runs] [threads]\n"
+                 "  '-' generates a random volume instead of reading it\n";
+    return 1;
+  }
+
+  std::string pet_dir = argv[1];
+  std::string ct_dir = argv[2];
+  int depth = argc >= 4 ? std::atoi(argv[3]) : 246;
+  int runs = argc >= 5 ? std::atoi(argv[4]) : 10;
+  int threads = argc >= 6 ? std::atoi(argv[5]) : sw_num_threads();
+
+  const size_t V = (size_t)DIMENSION * DIMENSION * depth;
+  std::vector<uint8_t> flt(V), ref(V);
+
+  srand(1234);
+  if (pet_dir == "-") {
+    for (size_t i = 0; i < V; i++)
+      flt[i] = static_cast<uint8_t>(rand() % 256);
+  } else {
+    std::cout << "Loading PET volume...\n";
+    read_volume_from_folder(flt.data(), DIMENSION, depth, pet_dir);
+  }
+  if (ct_dir == "-") {
+    for (size_t i = 0; i < V; i++)
+      ref[i] = static_cast<uint8_t>(rand() % 256);
+  } else {
+    std::cout << "Loading CT reference...\n";
+    read_volume_from_folder(ref.data(), DIMENSION, depth, ct_dir);
+  }
+
+  std::cout << "Volume: " << DIMENSION << "x" << DIMENSION << "x" << depth
+            << ", runs: " << runs << ", threads: " << threads
+            << ", sub-histograms: " << J_HISTO_LANES << "\n";
+
+  std::vector<double> baseline_histogram(J_HISTO_BINS);
+  auto *j_h_baseline = reinterpret_cast<double (*)[J_HISTO_COLS]>(
+      baseline_histogram.data());
+  std::vector<uint32_t> j_h(J_HISTO_BINS);
+  JointHistogramWorkspace workspace; // scratch memory shared by the timed runs
+
+  double t_baseline = time_runs(runs, [&]() {
+    joint_histogram_baseline(depth, ref.data(), flt.data(), j_h_baseline);
+  });
+  double t_single = time_runs(runs, [&]() {
+    joint_histogram_3d(ref.data(), flt.data(), j_h.data(), DIMENSION, depth,
+                       depth, 1, &workspace);
+  });
+  double t_multi = time_runs(runs, [&]() {
+    joint_histogram_3d(ref.data(), flt.data(), j_h.data(), DIMENSION, depth,
+                       depth, threads, &workspace);
+  });
+
+  for (int b = 0; b < J_HISTO_BINS; b++) {
+    if (j_h[b] != (uint32_t)baseline_histogram[b]) {
+      std::cerr << "Error: histogram mismatch at bin " << b << "\n";
+      return 1;
+    }
+  }
+
+  std::ofstream csv = append_csv("mi_benchmark.csv", "kernel,threads,time,voxels_per_s");
+  auto report = [&](const char *name, int n_threads, double t) {
+    std::cout << name << " (" << n_threads << " thread"
+              << (n_threads != 1 ? "s" : "") << "): " << t << " s, "
+              << V / t / 1e9 << " Gvoxels/s\n";
+    csv << name << "," << n_threads << "," << t << "," << V / t << "\n";
+  };
+  report("baseline", 1, t_baseline);
+  report("memory-order", 1, t_single);
+  report("memory-order", threads, t_multi);
+
+  std::cout << "Speedup over baseline: " << t_baseline / t_single
+            << "x (1 thread), " << t_baseline / t_multi << "x (" << threads
+            << " threads)\n";
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
 #ifdef COYOTE_MODE
@@ -16,6 +17,8 @@
 
 #endif
 #include "constants.h" // DIMENSION, HIST_PE, J_HISTO_ROWS, J_HISTO_COLS
+#include "irg_app/include/software_mi/entropy.hpp"
+#include "irg_app/include/software_mi/joint_histogram.hpp"
 
 #define DEFAULT_DEVICE_ID 0
 
@@ -147,62 +150,14 @@ double software_mi(int n_couples, const uint8_t *input_ref,
   const int padding = 0;
   int N = n_couples + padding;
 
-  // Build joint histogram j_h[a][b]
-  double j_h[J_HISTO_ROWS][J_HISTO_COLS] = {{0.0}};
-  for (int k = 0; k < N; ++k) {
-    for (int i = 0; i < DIMENSION; ++i) {
-      for (int j = 0; j < DIMENSION; ++j) {
-        int idx = i * DIMENSION * N + j * N + k;
-        unsigned a = input_ref[idx];
-        unsigned b = input_flt[idx];
-        j_h[a][b] += 1.0;
-      }
-    }
-  }
-
-  // Normalize histogram to probabilities
-  double norm = double(N) * DIMENSION * DIMENSION;
-  for (int i = 0; i < J_HISTO_ROWS; ++i) {
-    for (int j = 0; j < J_HISTO_COLS; ++j) {
-      j_h[i][j] /= norm;
-    }
-  }
-
-  // Compute joint entropy H(X,Y)
-  double Hxy = 0.0;
-  for (int i = 0; i < J_HISTO_ROWS; ++i) {
-    for (int j = 0; j < J_HISTO_COLS; ++j) {
-      double p = j_h[i][j];
-      if (p > 1e-15) {
-        Hxy -= p * std::log2(p);
-      }
-    }
-  }
-
-  // Compute marginal distributions px and py
-  double px[J_HISTO_ROWS] = {0.0}, py[J_HISTO_COLS] = {0.0};
-  for (int i = 0; i < J_HISTO_ROWS; ++i) {
-    for (int j = 0; j < J_HISTO_COLS; ++j) {
-      px[i] += j_h[i][j];
-      py[j] += j_h[i][j];
-    }
-  }
-
-  // Compute marginal entropies H(X) and H(Y)
-  double Hx = 0.0, Hy = 0.0;
-  for (int i = 0; i < J_HISTO_ROWS; ++i) {
-    if (px[i] > 1e-15) {
-      Hx -= px[i] * std::log2(px[i]);
-    }
-  }
-  for (int j = 0; j < J_HISTO_COLS; ++j) {
-    if (py[j] > 1e-15) {
-      Hy -= py[j] * std::log2(py[j]);
-    }
-  }
+  // Build joint histogram j_h[a][b] (shared memory-order kernel, integer counts)
+  std::vector<uint32_t> j_h(J_HISTO_BINS);
+  joint_histogram_3d(input_ref, input_flt, j_h.data(), DIMENSION, N, n_couples);
 
-  // MI = H(X) + H(Y) – H(X,Y)
-  return Hx + Hy - Hxy;
+  // MI = H(X) + H(Y) – H(X,Y), from the integer counts
+  return mutual_information_from_counts(j_h.data(),
+                                        (uint64_t)n_couples * DIMENSION *
+                                            DIMENSION);
 }
 
 // ----------------------------------------------------------------------------
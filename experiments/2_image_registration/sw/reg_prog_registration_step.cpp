@@ -17,6 +17,8 @@
 #define DEFAULT_VFPGA_ID 0
 
 #include "constants.h" // DIMENSION, HIST_PE, J_HISTO_ROWS, J_HISTO_COLS
+#include "irg_app/include/software_mi/entropy.hpp"
+#include "irg_app/include/software_mi/joint_histogram.hpp"
 
 __device__ void dummy_sleep() {
   int tot = 0;
@@ -204,84 +206,16 @@ __global__ void gpu_invoke(volatile uint32_t *ctrl_reg, int coper,
 }
 
 double software_mi(int n_couples, uint8_t *input_ref, uint8_t *input_flt) {
-  double j_h[J_HISTO_ROWS][J_HISTO_COLS];
-  for (int i = 0; i < J_HISTO_ROWS; i++) {
-    for (int j = 0; j < J_HISTO_COLS; j++) {
-      j_h[i][j] = 0.0;
-    }
-  }
-
   const int N_COUPLES_TOTAL = n_couples;
 
-  for (int k = 0; k < N_COUPLES_TOTAL; k++) {
-    for (int i = 0; i < DIMENSION; i++) {
-      for (int j = 0; j < DIMENSION; j++) {
-        unsigned int a = input_ref[i * DIMENSION * (N_COUPLES_TOTAL) +
-                                   j * (N_COUPLES_TOTAL) + k];
-        unsigned int b = input_flt[i * DIMENSION * (N_COUPLES_TOTAL) +
-                                   j * (N_COUPLES_TOTAL) + k];
-        j_h[a][b] = (j_h[a][b]) + 1;
-      }
-    }
-  }
-
-  for (int i = 0; i < J_HISTO_ROWS; i++) {
-    for (int j = 0; j < J_HISTO_COLS; j++) {
-      j_h[i][j] = j_h[i][j] / ((N_COUPLES_TOTAL)*DIMENSION * DIMENSION);
-    }
-  }
-
-  float entropy = 0.0;
-  for (int i = 0; i < J_HISTO_ROWS; i++) {
-    for (int j = 0; j < J_HISTO_COLS; j++) {
-      float v = j_h[j][i];
-      if (v > 0.000000000000001) {
-        entropy += v * log2(v);
-      }
-    }
-  }
-  entropy *= -1;
-
-  double href[ANOTHER_DIMENSION];
-  for (int i = 0; i < ANOTHER_DIMENSION; i++) {
-    href[i] = 0.0;
-  }
-
-  for (int i = 0; i < ANOTHER_DIMENSION; i++) {
-    for (int j = 0; j < ANOTHER_DIMENSION; j++) {
-      href[i] += j_h[i][j];
-    }
-  }
-
-  double hflt[ANOTHER_DIMENSION];
-  for (int i = 0; i < ANOTHER_DIMENSION; i++) {
-    hflt[i] = 0.0;
-  }
-
-  for (int i = 0; i < J_HISTO_ROWS; i++) {
-    for (int j = 0; j < J_HISTO_COLS; j++) {
-      hflt[i] += j_h[j][i];
-    }
-  }
-
-  double eref = 0.0;
-  for (int i = 0; i < ANOTHER_DIMENSION; i++) {
-    if (href[i] > 0.000000000001) {
-      eref += href[i] * log2(href[i]);
-    }
-  }
-  eref *= -1;
-
-  double eflt = 0.0;
-  for (int i = 0; i < ANOTHER_DIMENSION; i++) {
-    if (hflt[i] > 0.000000000001) {
-      eflt += hflt[i] * log2(hflt[i]);
-    }
-  }
-  eflt = eflt * (-1);
+  // joint histogram from the shared memory-order kernel (integer counts)
+  std::vector<uint32_t> j_h(J_HISTO_BINS);
+  joint_histogram_3d(input_ref, input_flt, j_h.data(), DIMENSION,
+                     N_COUPLES_TOTAL, N_COUPLES_TOTAL);
 
-  double mutualinfo = eref + eflt - entropy;
-  return mutualinfo;
+  // entropies from the integer counts: H = log2(N) - sum c*log2(c)/N
+  return mutual_information_from_counts(
+      j_h.data(), (uint64_t)N_COUPLES_TOTAL * DIMENSION * DIMENSION);
 }
 
 void compute_mi(coyote::cThread &coyote_thread, uint8_t *input_flt,
@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "constants.h" // DIMENSION
+#include "irg_app/core/register_algorithms.hpp"
+#include "irg_app/infrastructure/file_repository.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Software registration with a voxel-sampling schedule vs full resolution
+// =============================================================================
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <PET_folder> <CT_folder> [depth] [schedule]\n"
+                 "  schedule: comma-separated sampling fraction of the first "
+                 "Powell sweeps (default 0.1)\n";
+    return 1;
+  }
+
+  std::string pet_path = argv[1];
+  std::string ct_path = argv[2];
+  int depth = argc >= 4 ? std::atoi(argv[3]) : 246;
+  std::string schedule_text = argc >= 5 ? argv[4] : "0.1";
+  const int padding = 0;
+
+  file_repository files(ct_path, pet_path);
+  std::vector<cv::Mat> reference_image = files.reference_image_3d(depth);
+  std::vector<cv::Mat> floating_image = files.floating_image_3d(depth);
+  std::vector<uint8_t> registered_volume((size_t)DIMENSION * DIMENSION *
+                                         (depth + padding));
+
+  mutualinformation full, sampled;
+  std::cout << "-- full resolution" << std::endl;
+  set_sw_mi_schedule({1.0});
+  double t_full = full.register_images_3d(reference_image, floating_image,
+                                          depth, padding, 0, 0, 0,
+                                          registered_volume.data());
+  std::cout << "-- sampled (" << schedule_text << ")" << std::endl;
+  set_sw_mi_schedule(parse_sw_mi_schedule(schedule_text));
+  double t_sampled = sampled.register_images_3d(reference_image,
+                                                floating_image, depth, padding,
+                                                0, 0, 0,
+                                                registered_volume.data());
+
+  const double d_tx = std::fabs(sampled.final_params[0] - full.final_params[0]);
+  const double d_ty = std::fabs(sampled.final_params[1] - full.final_params[1]);
+  const double d_ang = std::fabs(sampled.final_params[2] - full.final_params[2]);
+  std::cout << "Final MI: full " << full.final_mutual_inf << ", sampled "
+            << sampled.final_mutual_inf << " (difference "
+            << sampled.final_mutual_inf - full.final_mutual_inf << ")\n"
+            << "Transform difference: tx " << d_tx << " px, ty " << d_ty
+            << " px, ang " << d_ang << " rad\n"
+            << "Time: full " << t_full << " s, sampled " << t_sampled
+            << " s, speedup " << t_full / t_sampled << "x\n";
+
+  std::ofstream csv = append_csv("sampled_registration.csv",
+                                "schedule,full_time,sampled_time,full_mi,sampled_mi,d_tx,d_ty,d_ang");
+  csv << "\"" << schedule_text << "\"," << t_full << "," << t_sampled << ","
+      << full.final_mutual_inf << "," << sampled.final_mutual_inf << ","
+      << d_tx << "," << d_ty << "," << d_ang << "\n";
+  return 0;
+}
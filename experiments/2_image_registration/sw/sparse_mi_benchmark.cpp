@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
+#include "constants.h" // DIMENSION
+#include "irg_app/include/software_mi/software_mi.cpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Dense vs foreground-sparse software MI (warp fused into the histogram)
+// =============================================================================
+
+// disc of random intensities in every layer, covering about FRACTION of the plane
+void generate_foreground(uint8_t *volume, int depth, double fraction, int shift) {
+  const double radius2 = fraction * DIMENSION * DIMENSION / 3.14159265;
+  for (int r = 0; r < DIMENSION; r++) {
+    for (int c = 0; c < DIMENSION; c++) {
+      const double dr = r - DIMENSION / 2.0 - shift, dc = c - DIMENSION / 2.0 + shift;
+      for (int k = 0; k < depth; k++) {
+        volume[((size_t)r * DIMENSION + c) * depth + k] =
+            dr * dr + dc * dc < radius2 ? 1 + rand() % 255 : 0;
+      }
+    }
+  }
+}
+
+template <typename F> double time_runs(int runs, F function) {
+  function(); // warmup
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < runs; r++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count() / runs;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <PET_folder|-> <CT_folder|-> [depth] [runs] [foreground]\n"
+                 "  '-' generates a disc covering the <foreground> fraction "
+                 "(default 0.3) of each slice\n";
+    return 1;
+  }
+
+  std::string pet_dir = argv[1];
+  std::string ct_dir = argv[2];
+  int depth = argc >= 4 ? std::atoi(argv[3]) : 246;
+  int runs = argc >= 5 ? std::atoi(argv[4]) : 3;
+  double fraction = argc >= 6 ? std::atof(argv[5]) : 0.3;
+
+  const size_t V = (size_t)DIMENSION * DIMENSION * depth;
+  std::vector<uint8_t> flt(V), ref(V);
+
+  srand(1234);
+  if (pet_dir == "-") {
+    generate_foreground(flt.data(), depth, fraction, 10);
+  } else {
+    std::cout << "Loading PET volume...\n";
+    read_volume_from_folder(flt.data(), DIMENSION, depth, pet_dir);
+  }
+  if (ct_dir == "-") {
+    generate_foreground(ref.data(), depth, fraction, 0);
+  } else {
+    std::cout << "Loading CT reference...\n";
+    read_volume_from_folder(ref.data(), DIMENSION, depth, ct_dir);
+  }
+
+  auto index_start = std::chrono::high_resolution_clock::now();
+  const ForegroundIndex foreground =
+      build_foreground_index(ref.data(), flt.data(), DIMENSION, depth, depth);
+  std::chrono::duration<double> t_index = std::chrono::high_resolution_clock::now() - index_start;
+
+  // golden-section probe pair around a small misalignment
+  const std::vector<rigid_transform> candidates{{5, -3, 0.05f}, {8, -3, 0.05f}};
+  std::vector<double> mi_dense, mi_sparse;
+  double t_dense = time_runs(runs, [&]() {
+    mi_dense = sw_registration_step_3d_batch(ref.data(), flt.data(), candidates, depth, 0);
+  });
+  double t_sparse = time_runs(runs, [&]() {
+    mi_sparse = sw_registration_step_3d_batch(ref.data(), flt.data(), candidates, depth, 0, &foreground);
+  });
+
+  for (size_t c = 0; c < candidates.size(); c++) {
+    if (mi_dense[c] != mi_sparse[c]) {
+      std::cerr << "Error: sparse MI " << mi_sparse[c] << " differs from dense MI " << mi_dense[c] << "\n";
+      return 1;
+    }
+  }
+
+  const double reference_fraction = foreground.reference_fraction();
+  std::cout << "Volume: " << DIMENSION << "x" << DIMENSION << "x" << depth
+            << ", runs: " << runs << ", threads: " << sw_num_threads() << "\n"
+            << "Reference foreground: " << reference_fraction * 100 << "% of the columns, index built in "
+            << t_index.count() << " s\n"
+            << "dense: " << t_dense << " s, sparse: " << t_sparse << " s per probe pair\n"
+            << "Speedup: " << t_dense / t_sparse << "x (1 / foreground = " << 1.0 / reference_fraction << "x)\n";
+
+  std::ofstream csv = append_csv("sparse_mi_benchmark.csv",
+                                "depth,foreground,dense_time,sparse_time,speedup");
+  csv << depth << "," << reference_fraction << "," << t_dense << "," << t_sparse << "," << t_dense / t_sparse << "\n";
+  return 0;
+}
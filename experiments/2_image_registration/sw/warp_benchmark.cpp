@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
+#include "constants.h" // DIMENSION
+#include "irg_app/include/image_utils/image_utils.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Throughput of the CPU warp: one voxel at a time vs one depth column at a time,
+// serial and multi-threaded, and the fixed-point bilinear variant; optionally
+// dumps the source-access profile of the bilinear warp
+// =============================================================================
+
+template <typename F> double time_runs(int runs, F function) {
+  function(); // warmup
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < runs; r++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count() / runs;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <PET_folder|-> [depth] [runs] [threads] [profile_csv]\n"
+                 "  '-' generates a random volume instead of reading it\n";
+    return 1;
+  }
+
+  std::string pet_dir = argv[1];
+  int depth = argc >= 3 ? std::atoi(argv[2]) : 246;
+  int runs = argc >= 4 ? std::atoi(argv[3]) : 3;
+  int threads = argc >= 5 ? std::atoi(argv[4]) : sw_num_threads();
+  std::string profile_path = argc >= 6 ? argv[5] : "";
+
+  const float TX = -14.f, TY = -7.f, ANG = 0.1f; // radians
+  const size_t V = (size_t)DIMENSION * DIMENSION * depth;
+  std::vector<uint8_t> flt(V), out_voxelwise(V), out_column(V);
+  // left uninitialized, so the parallel warp does the first touch of its rows
+  std::unique_ptr<uint8_t[]> out_parallel(new uint8_t[V]);
+
+  srand(1234);
+  if (pet_dir == "-") {
+    for (size_t i = 0; i < V; i++)
+      flt[i] = static_cast<uint8_t>(rand() % 256);
+  } else {
+    std::cout << "Loading PET volume...\n";
+    read_volume_from_folder(flt.data(), DIMENSION, depth, pet_dir);
+  }
+
+  std::cout << "Volume: " << DIMENSION << "x" << DIMENSION << "x" << depth
+            << ", runs: " << runs << ", threads: " << threads << "\n";
+
+  std::ofstream csv = append_csv("warp_benchmark.csv", "mode,engine,threads,time,voxels_per_s");
+  for (const bool bilinear : {MODE_BILINEAR, MODE_NEAREST}) {
+    const char *mode = bilinear ? "bilinear" : "nearest";
+    double t_voxelwise = time_runs(runs, [&]() {
+      transform_volume_voxelwise(flt.data(), out_voxelwise.data(), TX, TY, ANG, DIMENSION, depth, bilinear);
+    });
+    double t_column = time_runs(runs, [&]() {
+      transform_volume(flt.data(), out_column.data(), TX, TY, ANG, DIMENSION, depth, bilinear, 1);
+    });
+    double t_parallel = time_runs(runs, [&]() {
+      transform_volume(flt.data(), out_parallel.get(), TX, TY, ANG, DIMENSION, depth, bilinear, threads);
+    });
+
+    if (std::memcmp(out_column.data(), out_parallel.get(), V) != 0) {
+      std::cerr << "Error: " << mode << " output depends on the number of threads\n";
+      return 1;
+    }
+
+    size_t mismatches = 0;
+    for (size_t v = 0; v < V; v++)
+      mismatches += out_voxelwise[v] != out_column[v];
+    // the voxelwise nearest-neighbour offsets are rounded in float arithmetic (see transform_rows)
+    if (bilinear && mismatches != 0) {
+      std::cerr << "Error: " << mismatches << " bilinear voxels differ\n";
+      return 1;
+    }
+
+    std::cout << mode << ": voxelwise " << t_voxelwise << " s ("
+              << V / t_voxelwise / 1e6 << " Mvoxels/s), column " << t_column
+              << " s (" << V / t_column / 1e6 << " Mvoxels/s), speedup "
+              << t_voxelwise / t_column << "x, " << threads << " threads "
+              << t_parallel << " s (" << V / t_parallel / 1e6
+              << " Mvoxels/s), speedup " << t_column / t_parallel << "x";
+    if (mismatches != 0)
+      std::cout << ", " << mismatches << " voxels differ";
+    std::cout << "\n";
+    csv << mode << ",voxelwise,1," << t_voxelwise << "," << V / t_voxelwise << "\n";
+    csv << mode << ",column,1," << t_column << "," << V / t_column << "\n";
+    csv << mode << ",column," << threads << "," << t_parallel << "," << V / t_parallel << "\n";
+
+    if (!bilinear) continue;
+
+    // fixed-point bilinear (Q16 positions, 8-bit weight table) against the float column warp
+    std::vector<uint8_t> out_fixed(V);
+    double t_fixed = time_runs(runs, [&]() {
+      transform_volume_fixed_point(flt.data(), out_fixed.data(), TX, TY, ANG, DIMENSION, depth, 1);
+    });
+    size_t exact = 0;
+    int max_deviation = 0;
+    double total_deviation = 0.0;
+    for (size_t v = 0; v < V; v++) {
+      const int deviation = std::abs((int)out_fixed[v] - (int)out_column[v]);
+      exact += deviation == 0;
+      max_deviation = std::max(max_deviation, deviation);
+      total_deviation += deviation;
+    }
+    std::cout << "bilinear fixed-point: " << t_fixed << " s ("
+              << V / t_fixed / 1e6 << " Mvoxels/s), speedup over float "
+              << t_column / t_fixed << "x, deviation: max " << max_deviation
+              << ", mean " << total_deviation / V << ", " << 100.0 * exact / V
+              << "% exact\n";
+    csv << "bilinear-fixed-point,column,1," << t_fixed << "," << V / t_fixed << "\n";
+  }
+
+  // source-access profile of the bilinear warp (reuse distances and row spans per thread)
+  if (!profile_path.empty()) {
+    std::vector<AccessProfile> profiles;
+    std::vector<uint8_t> out_profiled(V);
+    double t_profiled = time_runs(1, [&]() {
+      transform_volume_profiled(flt.data(), out_profiled.data(), TX, TY, ANG, DIMENSION, depth, MODE_BILINEAR, profiles, threads);
+    });
+    if (!write_access_profiles(profiles, profile_path)) {
+      std::cerr << "Error: cannot write " << profile_path << "\n";
+      return 1;
+    }
+    std::cout << "Access profile of the bilinear warp (" << t_profiled
+              << " s) written to " << profile_path << "\n";
+  }
+  return 0;
+}
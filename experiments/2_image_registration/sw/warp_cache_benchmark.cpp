@@ -0,0 +1,152 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
+#include "constants.h" // DIMENSION
+#include "irg_app/include/image_utils/image_utils.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Throughput of the bilinear CPU warp: hash-map read cache vs line buffer
+// =============================================================================
+
+// original GribbonBailey strategy (function-static hash map, global counters),
+// kept as the baseline
+long hashmap_hits = 0;
+long hashmap_misses = 0;
+
+uint8_t read_hashmap(uint8_t *source, int Pi, int Pj, int k, int index) {
+  struct CacheElem {
+    int y;
+    uint8_t value;
+  };
+  static std::unordered_map<int, CacheElem> cache;
+
+  if (index == -1) return 0;
+  if (k > 0) return source[index];
+
+  bool hit = (cache.find(Pi) != cache.end() && cache[Pi].y == Pj);
+  if (hit) {
+    hashmap_hits++;
+    return cache[Pi].value;
+  }
+
+  hashmap_misses++;
+  uint8_t new_value = source[index];
+  cache[Pi] = {Pj, new_value};
+  return new_value;
+}
+
+void transform_volume_hashmap(uint8_t *src, uint8_t *dest, float TX, float TY,
+                              float ANG, int SIZE, int LAYERS) {
+  for (int i = 0; i < SIZE; i++) {
+    for (int j = 0; j < SIZE; j++) {
+      for (int k = 0; k < LAYERS; k++) {
+        const float P_i = (i - SIZE / 2.f - TX) * std::cos(ANG) - (j - SIZE / 2.f - TY) * std::sin(ANG) + (SIZE / 2.f);
+        const float P_j = (i - SIZE / 2.f - TX) * std::sin(ANG) + (j - SIZE / 2.f - TY) * std::cos(ANG) + (SIZE / 2.f);
+        const float P_left = std::floor(P_i), P_right = std::ceil(P_i);
+        const float P_top = std::floor(P_j), P_bottom = std::ceil(P_j);
+
+        auto index = [&](float x, float y) {
+          return !is_out_of_bounds(SIZE, LAYERS, x, y) ? compute_buffer_offset<int>(SIZE, LAYERS, x, y, k) : -1;
+        };
+        const float Q11_val = read_hashmap(src, P_left, P_top, k, index(P_left, P_top));
+        const float Q12_val = read_hashmap(src, P_right, P_top, k, index(P_right, P_top));
+        const float Q21_val = read_hashmap(src, P_left, P_bottom, k, index(P_left, P_bottom));
+        const float Q22_val = read_hashmap(src, P_right, P_bottom, k, index(P_right, P_bottom));
+
+        const float R_i = P_i - P_left, R_j = P_j - P_top;
+        const float val_left = Q11_val * (1.f - R_i) + Q12_val * R_i;
+        const float val_right = Q21_val * (1.f - R_i) + Q22_val * R_i;
+        dest[j * SIZE * LAYERS + i * LAYERS + k] = std::round(val_left * (1.f - R_j) + val_right * R_j);
+      }
+    }
+  }
+}
+
+// transform_volume with the line buffer, counting its hits and misses
+void transform_volume_line_buffer(uint8_t *src, uint8_t *dest, float TX,
+                                  float TY, float ANG, int SIZE, int LAYERS,
+                                  LineBuffer &cache) {
+  cache.reset();
+  for (int i = 0; i < SIZE; i++)
+    for (int j = 0; j < SIZE; j++)
+      for (int k = 0; k < LAYERS; k++)
+        dest[j * SIZE * LAYERS + i * LAYERS + k] =
+            transform_bilinear(src, TX, TY, ANG, SIZE, LAYERS, i, j, k, &cache);
+}
+
+template <typename F> double time_runs(int runs, F function) {
+  function(); // warmup
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < runs; r++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count() / runs;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <PET_folder|-> [depth] [runs]\n"
+                 "  '-' generates a random volume instead of reading it\n";
+    return 1;
+  }
+
+  std::string pet_dir = argv[1];
+  int depth = argc >= 3 ? std::atoi(argv[2]) : 246;
+  int runs = argc >= 4 ? std::atoi(argv[3]) : 3;
+
+  const float TX = -14.f, TY = -7.f, ANG = 0.1f; // radians
+  const size_t V = (size_t)DIMENSION * DIMENSION * depth;
+  std::vector<uint8_t> flt(V), out_hashmap(V), out_line_buffer(V), out_direct(V);
+
+  srand(1234);
+  if (pet_dir == "-") {
+    for (size_t i = 0; i < V; i++)
+      flt[i] = static_cast<uint8_t>(rand() % 256);
+  } else {
+    std::cout << "Loading PET volume...\n";
+    read_volume_from_folder(flt.data(), DIMENSION, depth, pet_dir);
+  }
+
+  std::cout << "Volume: " << DIMENSION << "x" << DIMENSION << "x" << depth
+            << ", runs: " << runs << ", line buffer rows: " << LINE_BUFFER_ROWS
+            << "\n";
+
+  LineBuffer cache;
+  double t_hashmap = time_runs(runs, [&]() {
+    hashmap_hits = hashmap_misses = 0;
+    transform_volume_hashmap(flt.data(), out_hashmap.data(), TX, TY, ANG, DIMENSION, depth);
+  });
+  double t_line_buffer = time_runs(runs, [&]() {
+    transform_volume_line_buffer(flt.data(), out_line_buffer.data(), TX, TY, ANG, DIMENSION, depth, cache);
+  });
+  transform_volume(flt.data(), out_direct.data(), TX, TY, ANG, DIMENSION, depth, MODE_BILINEAR);
+
+  if (std::memcmp(out_hashmap.data(), out_line_buffer.data(), V) != 0 ||
+      std::memcmp(out_hashmap.data(), out_direct.data(), V) != 0) {
+    std::cerr << "Error: warped volumes differ\n";
+    return 1;
+  }
+
+  std::ofstream csv = append_csv("warp_cache_benchmark.csv", "cache,time,voxels_per_s,hit_rate");
+  auto report = [&](const char *name, double t, long hits, long misses) {
+    const double hit_rate = hits + misses > 0 ? (double)hits / (hits + misses) : 0.0;
+    std::cout << name << ": " << t << " s, " << V / t / 1e6 << " Mvoxels/s, "
+              << 100.0 * hit_rate << "% hits on the k = 0 plane\n";
+    csv << name << "," << t << "," << V / t << "," << hit_rate << "\n";
+  };
+  report("hash-map", t_hashmap, hashmap_hits, hashmap_misses);
+  report("line-buffer", t_line_buffer, cache.hits, cache.misses);
+
+  std::cout << "Speedup over hash-map: " << t_hashmap / t_line_buffer << "x\n";
+  return 0;
+}
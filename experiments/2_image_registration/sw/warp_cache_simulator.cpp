@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "constants.h" // DIMENSION, NUM_PIXELS_PER_READ, INPUT_DATA_BITWIDTH_FETCHER
+#include "irg_app/include/image_utils/image_utils.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Offline cache-design simulator for the source reads of the bilinear warp
+// =============================================================================
+//
+// The access stream is the one of transform_volume (column engine, output rows
+// in order, 4 source pixels per output pixel), replayed on a single plane for a
+// sweep of (tx, ty, angle). Every design point caches blocks of
+// BLOCK_W x BLOCK_H source pixels of ENTRY_BYTES bytes each (1 when the FPGA
+// streams one slice at a time, the depth when whole columns are cached) and
+// starts empty at every transform.
+
+constexpr int BUS_BYTES = INPUT_DATA_BITWIDTH_FETCHER / 8; // bytes per memory beat of the fetcher
+
+// a block is fetched in ceil(bytes / BUS_BYTES) beats after MISS_LATENCY cycles
+struct StallModel {
+  int miss_latency;
+  int entry_bytes;
+};
+
+struct CacheDesign {
+  std::string name;
+  int block_w, block_h; // pixels per block
+  int sets, ways;
+  int line_rows;        // > 0: line buffer, set = (row % line_rows, block column)
+};
+
+class CacheModel {
+public:
+  explicit CacheModel(const CacheDesign &design, const int SIZE)
+      : design(design), blocks_per_row((SIZE + design.block_w - 1) / design.block_w),
+        tags((size_t)design.sets * design.ways, -1),
+        stamps((size_t)design.sets * design.ways, 0) {}
+
+  // true on a hit; on a miss the block replaces the least recently used way of its set
+  bool access(const int row, const int col) {
+    const int block_row = row / design.block_h;
+    const int block_col = col / design.block_w;
+    const long long block = (long long)block_row * blocks_per_row + block_col;
+    const int set = design.line_rows > 0
+                        ? (block_row % design.line_rows) * blocks_per_row + block_col
+                        : (int)(block % design.sets);
+
+    clock++;
+    long long *set_tags = tags.data() + (size_t)set * design.ways;
+    uint64_t *set_stamps = stamps.data() + (size_t)set * design.ways;
+    int victim = 0;
+    for (int w = 0; w < design.ways; w++) {
+      if (set_tags[w] == block) {
+        set_stamps[w] = clock;
+        return true;
+      }
+      if (set_stamps[w] < set_stamps[victim]) victim = w;
+    }
+    set_tags[victim] = block;
+    set_stamps[victim] = clock;
+    return false;
+  }
+
+  void clear() {
+    std::fill(tags.begin(), tags.end(), -1);
+    std::fill(stamps.begin(), stamps.end(), 0);
+  }
+
+  const CacheDesign design;
+
+private:
+  const int blocks_per_row;
+  std::vector<long long> tags;
+  std::vector<uint64_t> stamps;
+  uint64_t clock = 0;
+};
+
+// Tracker policy of transform_rows (see access_profile.hpp) feeding every source read to all the designs
+struct CacheSimulator {
+  std::vector<CacheModel> caches;
+  StallModel stall;
+  int SIZE = 0;
+  int LAYERS = 1;
+
+  uint64_t reads = 0;
+  std::vector<uint64_t> hits;
+  std::vector<uint64_t> row_stall;       // stall of the current output row, per design
+  std::vector<uint64_t> worst_row_stall; // over all rows and transforms, per design
+  std::vector<uint64_t> total_stall;
+
+  CacheSimulator(const std::vector<CacheDesign> &designs, const StallModel &stall, const int SIZE)
+      : stall(stall), SIZE(SIZE), hits(designs.size(), 0), row_stall(designs.size(), 0),
+        worst_row_stall(designs.size(), 0), total_stall(designs.size(), 0) {
+    for (const CacheDesign &design : designs)
+      caches.emplace_back(design, SIZE);
+  }
+
+  uint64_t miss_cycles(const CacheDesign &design) const {
+    const int bytes = design.block_w * design.block_h * stall.entry_bytes;
+    return stall.miss_latency + (bytes + BUS_BYTES - 1) / BUS_BYTES;
+  }
+
+  // called once per transform: every design starts cold. The size is fixed at construction (the caches are
+  // laid out for it), so the tracker's SIZE and MAX_READS are not needed.
+  void reset(int /* SIZE */, const int LAYERS, int /* MAX_READS */) {
+    this->LAYERS = LAYERS;
+    for (CacheModel &cache : caches) cache.clear();
+  }
+
+  void begin_row() { std::fill(row_stall.begin(), row_stall.end(), 0); }
+
+  void read_column(const int offset) {
+    const int pixel = offset / LAYERS;
+    const int row = pixel / SIZE, col = pixel % SIZE;
+    reads++;
+    for (size_t d = 0; d < caches.size(); d++) {
+      if (caches[d].access(row, col)) hits[d]++;
+      else row_stall[d] += miss_cycles(caches[d].design);
+    }
+  }
+
+  void end_row() {
+    for (size_t d = 0; d < caches.size(); d++) {
+      worst_row_stall[d] = std::max(worst_row_stall[d], row_stall[d]);
+      total_stall[d] += row_stall[d];
+    }
+  }
+};
+
+std::vector<CacheDesign> default_designs(const int SIZE) {
+  std::vector<CacheDesign> designs;
+  // line buffers of N source rows, filled one bus word (NUM_PIXELS_PER_READ pixels) at a time
+  for (int rows : {2, 4, 8, 16, 32, 64}) {
+    const int segments = SIZE / NUM_PIXELS_PER_READ;
+    designs.push_back({"line-buffer-" + std::to_string(rows) + "-rows",
+                       NUM_PIXELS_PER_READ, 1, rows * segments, 1, rows});
+  }
+  // set-associative caches of square tiles
+  for (int tile : {8, 16}) {
+    for (int kbytes : {16, 64, 256}) {
+      for (int ways : {2, 4, 8}) {
+        const int blocks = kbytes * 1024 / (tile * tile);
+        designs.push_back({"tiles-" + std::to_string(tile) + "x" + std::to_string(tile) + "-" +
+                               std::to_string(kbytes) + "KiB-" + std::to_string(ways) + "way",
+                           tile, tile, blocks / ways, ways, 0});
+      }
+    }
+  }
+  return designs;
+}
+
+std::vector<double> linspace(const double low, const double high, const int steps) {
+  if (steps <= 1) return {0.0};
+  std::vector<double> values(steps);
+  for (int s = 0; s < steps; s++)
+    values[s] = low + (high - low) * s / (steps - 1);
+  return values;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && std::string(argv[1]) == "-h") {
+    std::cerr << "Usage: " << argv[0]
+              << " [max_translation] [max_angle_deg] [steps] [entry_bytes]"
+                 " [miss_latency] [bram36_blocks] [uram_blocks]\n";
+    return 1;
+  }
+
+  const double max_translation = argc >= 2 ? std::atof(argv[1]) : 20.0;
+  const double max_angle = argc >= 3 ? std::atof(argv[2]) : 10.0;
+  const int steps = argc >= 4 ? std::atoi(argv[3]) : 3;
+  const StallModel stall = {argc >= 6 ? std::atoi(argv[5]) : 64,
+                            argc >= 5 ? std::atoi(argv[4]) : 1};
+  const int bram_blocks = argc >= 7 ? std::atoi(argv[6]) : 2016; // 36 Kb blocks
+  const int uram_blocks = argc >= 8 ? std::atoi(argv[7]) : 960;  // 288 Kb blocks
+
+  const int SIZE = DIMENSION;
+  std::vector<uint8_t> plane((size_t)SIZE * SIZE), warped((size_t)SIZE * SIZE);
+  const std::vector<CacheDesign> designs = default_designs(SIZE);
+  CacheSimulator simulator(designs, stall, SIZE);
+
+  int transforms = 0;
+  for (double tx : linspace(-max_translation, max_translation, steps)) {
+    for (double ty : linspace(-max_translation, max_translation, steps)) {
+      for (double ang : linspace(-max_angle, max_angle, steps)) {
+        simulator.reset(SIZE, 1, 0);
+        transform_rows(plane.data(), warped.data(), tx, ty, ang * M_PI / 180.0, SIZE, 1,
+                       MODE_BILINEAR, 0, SIZE, simulator);
+        transforms++;
+      }
+    }
+  }
+
+  const double outputs = (double)transforms * SIZE * SIZE;
+  std::cout << "Replayed " << transforms << " transforms (|t| <= " << max_translation
+            << " px, |angle| <= " << max_angle << " deg), " << simulator.reads
+            << " source reads, " << stall.entry_bytes << " byte(s) per pixel, miss latency "
+            << stall.miss_latency << " cycles\n";
+  std::cout << "Uncached: " << 4.0 * stall.entry_bytes << " bytes per output pixel\n";
+
+  std::ofstream csv = append_csv("warp_cache_simulator.csv",
+                                "design,capacity_bytes,bram36,uram,fits,hit_rate,bytes_per_output,"
+                                "mean_row_stall,worst_row_stall");
+  for (size_t d = 0; d < designs.size(); d++) {
+    const CacheDesign &design = designs[d];
+    const long long block_bytes = (long long)design.block_w * design.block_h * stall.entry_bytes;
+    const long long capacity = block_bytes * design.sets * design.ways;
+    const long long bram = (capacity + 4607) / 4608;
+    const long long uram = (capacity + 36863) / 36864;
+    const bool fits = bram <= bram_blocks || uram <= uram_blocks;
+
+    const double hit_rate = (double)simulator.hits[d] / simulator.reads;
+    const double bytes_per_output = (simulator.reads - simulator.hits[d]) * (double)block_bytes / outputs;
+    const double mean_row_stall = (double)simulator.total_stall[d] / (transforms * (double)SIZE);
+
+    std::cout << design.name << ": " << capacity / 1024.0 << " KiB (" << bram << " BRAM36 / "
+              << uram << " URAM" << (fits ? "" : ", does not fit") << "), hit rate "
+              << 100.0 * hit_rate << "%, " << bytes_per_output << " B/output, row stall mean "
+              << mean_row_stall << " worst " << simulator.worst_row_stall[d] << " cycles\n";
+    csv << design.name << "," << capacity << "," << bram << "," << uram << "," << fits << ","
+        << hit_rate << "," << bytes_per_output << "," << mean_row_stall << ","
+        << simulator.worst_row_stall[d] << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "irg_app/include/image_utils/image_utils.hpp"
+
+// =============================================================================
+// Regression check of the CPU warp: transform_volume (column engine, clipped
+// row spans) must match transform_volume_voxelwise and the RigidWarp functor
+// shared with the HIP kernel (rigidWarpFunctor.hpp) voxel for voxel
+// =============================================================================
+//
+// The grid covers zero, positive and negative translations and angles, whole
+// and half-pixel shifts, transforms that move the volume partly or entirely out
+// of the frame, sizes and depths that are not multiples of the SIMD width, and
+// one or several threads. Nearest-neighbour warps use the direct-mapping engine
+// (the three-shear engine is approximate by design). Exits with 1 on any
+// mismatch.
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && std::string(argv[1]) == "-h") {
+    std::cerr << "Usage: " << argv[0] << " [threads]\n";
+    return 1;
+  }
+  const int threads = argc >= 2 ? std::atoi(argv[1]) : 3;
+
+  set_nearest_warp_engine(DIRECT_MAPPING);
+  srand(1234);
+
+  int configurations = 0, failures = 0;
+  auto compare = [](const char *reference, const std::vector<uint8_t> &expected,
+                     const std::vector<uint8_t> &actual, const int SIZE, const int LAYERS,
+                     const float TX, const float TY, const float ANG, const bool mode, const int n_threads) {
+    size_t differ = 0;
+    for (size_t i = 0; i < expected.size(); i++)
+      differ += expected[i] != actual[i];
+    if (differ != 0)
+      std::cerr << "Mismatch with " << reference << ": size " << SIZE << ", layers " << LAYERS << ", tx " << TX
+                << ", ty " << TY << ", ang " << ANG << ", "
+                << (mode == MODE_BILINEAR ? "bilinear" : "nearest") << ", " << n_threads
+                << " thread(s): " << differ << " voxels differ\n";
+    return differ == 0;
+  };
+
+  for (const int SIZE : {1, 7, 33, 64, 100}) {
+    for (const int LAYERS : {1, 3, 17, 32}) {
+      const size_t V = (size_t)SIZE * SIZE * LAYERS;
+      std::vector<uint8_t> src(V), expected(V), functor(V), actual(V);
+      for (size_t i = 0; i < V; i++)
+        src[i] = static_cast<uint8_t>(1 + rand() % 255);
+
+      const float S = (float)SIZE;
+      for (const float TX : {0.f, 3.f, -5.f, 2.5f, -0.5f, S, -S - 3.f, 2.f * S}) {
+        for (const float TY : {0.f, -2.f, 4.5f, S + 1.f, -S}) {
+          for (const float ANG : {0.f, 0.1f, -0.3f, (float)(M_PI / 2), (float)M_PI, -2.5f}) {
+            for (const bool mode : {MODE_BILINEAR, MODE_NEAREST}) {
+              // the nearest-neighbour warp takes whole-pixel translations
+              if (mode == MODE_NEAREST && (TX != std::trunc(TX) || TY != std::trunc(TY)))
+                continue;
+              // voxel (row j, column i, slice k) of both layouts is at (j * SIZE + i) * LAYERS + k
+              const RigidWarp warp = RigidWarp::make(SIZE, LAYERS, TX, TY, ANG, mode);
+              for (int j = 0; j < SIZE; j++)
+                for (int i = 0; i < SIZE; i++)
+                  for (int k = 0; k < LAYERS; k++)
+                    functor[((size_t)j * SIZE + i) * LAYERS + k] = warp(src.data(), j, i, k);
+              transform_volume_voxelwise(src.data(), expected.data(), TX, TY, ANG, SIZE, LAYERS, mode);
+
+              for (const int n_threads : {1, threads}) {
+                transform_volume(src.data(), actual.data(), TX, TY, ANG, SIZE, LAYERS, mode, n_threads);
+                configurations++;
+                const bool voxelwise_match = compare("transform_volume_voxelwise", expected, actual, SIZE, LAYERS, TX, TY, ANG, mode, n_threads);
+                const bool functor_match = compare("RigidWarp", functor, actual, SIZE, LAYERS, TX, TY, ANG, mode, n_threads);
+                failures += !(voxelwise_match && functor_match);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::cout << configurations - failures << " of " << configurations
+            << " configurations match transform_volume_voxelwise and RigidWarp\n";
+  return failures == 0 ? 0 : 1;
+}
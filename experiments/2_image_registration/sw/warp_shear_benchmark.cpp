@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HIPRigidWarp3D/src/utils/images_io.h" // read_volume_from_folder()
+#include "constants.h" // DIMENSION
+#include "irg_app/include/image_utils/image_utils.hpp"
+#include "irg_app/infrastructure/csv_file.hpp"
+
+// =============================================================================
+// Nearest-neighbour warp: direct mapping vs three-shear rotation, throughput
+// and accuracy over a sweep of angles, for a whole-pixel and a fractional
+// translation
+// =============================================================================
+//
+// The accuracy is measured against the RigidWarp functor of the HIP kernel,
+// which rounds the exact source position: for whole-pixel translations it is
+// the direct mapping, for fractional ones the direct CPU mapping truncates the
+// translation and the three-shear engine rounds it.
+
+template <typename F> double time_runs(int runs, F function) {
+  function(); // warmup
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < runs; r++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count() / runs;
+}
+
+// A 4-layer volume whose voxels hold their own (x, y) pixel coordinates: warped by both warps, it gives the
+// source pixel each of them picked for every output pixel. Bit 7 of layer 1 marks a source pixel, so the
+// zero-filled out-of-bounds pixels are recognized.
+constexpr int COORDINATE_LAYERS = 4;
+
+std::vector<uint8_t> coordinate_volume(const int SIZE) {
+  std::vector<uint8_t> volume((size_t)SIZE * SIZE * COORDINATE_LAYERS);
+  for (int y = 0; y < SIZE; y++) {
+    for (int x = 0; x < SIZE; x++) {
+      uint8_t *voxel = volume.data() + ((size_t)y * SIZE + x) * COORDINATE_LAYERS;
+      voxel[0] = x & 0xFF;
+      voxel[1] = (x >> 8) | 0x80;
+      voxel[2] = y & 0xFF;
+      voxel[3] = y >> 8;
+    }
+  }
+  return volume;
+}
+
+struct SourceDisplacement {
+  double differ = 0.0; // fraction of the pixels mapped by both warps whose source pixel differs
+  double mean = 0.0;   // mean distance between the two source pixels (px)
+  double max = 0.0;
+  long border = 0;     // pixels mapped by only one of the warps
+};
+
+// nearest-neighbour warp of the RigidWarp functor, one depth column at a time
+void reference_warp(const uint8_t *src, uint8_t *dest, const float TX, const float TY, const float ANG, const int SIZE, const int LAYERS) {
+  const RigidWarp warp = RigidWarp::make(SIZE, LAYERS, TX, TY, ANG, MODE_NEAREST);
+  for (int j = 0; j < SIZE; j++)
+    for (int i = 0; i < SIZE; i++)
+      warp.column(src, j, i, dest + ((size_t)j * SIZE + i) * LAYERS);
+}
+
+SourceDisplacement compare_sources(const std::vector<uint8_t> &reference, const std::vector<uint8_t> &shear, const int SIZE) {
+  SourceDisplacement result;
+  long both = 0, differ = 0;
+  for (size_t p = 0; p < (size_t)SIZE * SIZE; p++) {
+    const uint8_t *u = reference.data() + p * COORDINATE_LAYERS;
+    const uint8_t *v = shear.data() + p * COORDINATE_LAYERS;
+    const bool mapped_u = u[1] & 0x80, mapped_v = v[1] & 0x80;
+    if (mapped_u != mapped_v) result.border++;
+    if (!mapped_u || !mapped_v) continue;
+    const int dx = (u[0] | (u[1] & 0x7F) << 8) - (v[0] | (v[1] & 0x7F) << 8);
+    const int dy = (u[2] | u[3] << 8) - (v[2] | v[3] << 8);
+    const double distance = std::sqrt((double)(dx * dx + dy * dy));
+    both++;
+    differ += distance > 0.0;
+    result.mean += distance;
+    result.max = std::max(result.max, distance);
+  }
+  if (both > 0) {
+    result.differ = (double)differ / both;
+    result.mean /= both;
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <PET_folder|-> [depth] [runs] [threads] [max_angle_deg] [steps]\n"
+                 "  '-' generates a random volume instead of reading it\n";
+    return 1;
+  }
+
+  std::string pet_dir = argv[1];
+  int depth = argc >= 3 ? std::atoi(argv[2]) : 246;
+  int runs = argc >= 4 ? std::atoi(argv[3]) : 3;
+  int threads = argc >= 5 ? std::atoi(argv[4]) : sw_num_threads();
+  double max_angle = argc >= 6 ? std::atof(argv[5]) : 45.0;
+  int steps = std::max(1, argc >= 7 ? std::atoi(argv[6]) : 4);
+
+  const size_t V = (size_t)DIMENSION * DIMENSION * depth;
+  std::vector<uint8_t> flt(V), out_direct(V), out_shear(V), out_reference(V);
+
+  srand(1234);
+  if (pet_dir == "-") {
+    for (size_t i = 0; i < V; i++)
+      flt[i] = static_cast<uint8_t>(rand() % 256);
+  } else {
+    std::cout << "Loading PET volume...\n";
+    read_volume_from_folder(flt.data(), DIMENSION, depth, pet_dir);
+  }
+
+  std::cout << "Volume: " << DIMENSION << "x" << DIMENSION << "x" << depth
+            << ", runs: " << runs << ", threads: " << threads << "\n";
+
+  const std::vector<uint8_t> coordinates = coordinate_volume(DIMENSION);
+  std::vector<uint8_t> coordinates_reference(coordinates.size()), coordinates_shear(coordinates.size());
+  ShearBuffers buffers;
+
+  std::ofstream csv = append_csv("warp_shear_benchmark.csv",
+                                "tx,ty,angle_deg,depth,threads,direct_time,shear_time,voxels_differ,source_differ,"
+                                "mean_displacement,max_displacement");
+  const std::pair<float, float> translations[] = {{-14.f, -7.f}, {-14.6f, -7.4f}};
+  for (const auto &[TX, TY] : translations) {
+    std::cout << "Translation (" << TX << ", " << TY << ")\n";
+    for (int s = 0; s < steps; s++) {
+      const double degrees = steps == 1 ? max_angle : max_angle * s / (steps - 1);
+      const float ANG = degrees * M_PI / 180.0;
+
+      set_nearest_warp_engine(DIRECT_MAPPING);
+      double t_direct = time_runs(runs, [&]() {
+        transform_volume(flt.data(), out_direct.data(), TX, TY, ANG, DIMENSION, depth, MODE_NEAREST, threads);
+      });
+      double t_shear = time_runs(runs, [&]() {
+        transform_volume_three_shear(flt.data(), out_shear.data(), TX, TY, ANG, DIMENSION, depth, threads, &buffers);
+      });
+
+      // the engine selected at runtime must be the same warp
+      std::vector<uint8_t> out_selected(V);
+      set_nearest_warp_engine(THREE_SHEAR);
+      transform_volume(flt.data(), out_selected.data(), TX, TY, ANG, DIMENSION, depth, MODE_NEAREST, threads);
+      set_nearest_warp_engine(DIRECT_MAPPING);
+      if (std::memcmp(out_selected.data(), out_shear.data(), V) != 0) {
+        std::cerr << "Error: the runtime-selected engine differs from transform_volume_three_shear\n";
+        return 1;
+      }
+
+      reference_warp(flt.data(), out_reference.data(), TX, TY, ANG, DIMENSION, depth);
+      size_t voxels_differ = 0;
+      for (size_t v = 0; v < V; v++)
+        voxels_differ += out_reference[v] != out_shear[v];
+
+      reference_warp(coordinates.data(), coordinates_reference.data(), TX, TY, ANG, DIMENSION, COORDINATE_LAYERS);
+      transform_volume_three_shear(const_cast<uint8_t *>(coordinates.data()), coordinates_shear.data(), TX, TY, ANG, DIMENSION, COORDINATE_LAYERS, threads, &buffers);
+      const SourceDisplacement sources = compare_sources(coordinates_reference, coordinates_shear, DIMENSION);
+
+      std::cout << "angle " << degrees << " deg: direct " << t_direct << " s ("
+                << V / t_direct / 1e6 << " Mvoxels/s), three-shear " << t_shear << " s ("
+                << V / t_shear / 1e6 << " Mvoxels/s), speedup " << t_direct / t_shear
+                << "x; " << 100.0 * voxels_differ / V << "% voxels differ, "
+                << 100.0 * sources.differ << "% source pixels differ (mean "
+                << sources.mean << " px, max " << sources.max << " px, "
+                << sources.border << " border pixels)\n";
+      csv << TX << "," << TY << "," << degrees << "," << depth << "," << threads << "," << t_direct << ","
+          << t_shear << "," << (double)voxels_differ / V << "," << sources.differ << "," << sources.mean << ","
+          << sources.max << "\n";
+    }
+  }
+  return 0;
+}